@@ -84,7 +84,15 @@ public:
       hartids(default_hartids),
       explicit_hartids(false),
       real_time_clint(default_real_time_clint),
-      trigger_count(default_trigger_count)
+      trigger_count(default_trigger_count),
+      jit(false),
+      fuse(false),
+      skip_idle(false),
+      threads(1),
+      deterministic(false),
+      tlb_sets(256),
+      tlb_ways(4),
+      tlb_stats(false)
   {}
 
   cfg_arg_t<std::pair<reg_t, reg_t>> initrd_bounds;
@@ -101,6 +109,15 @@ public:
   bool                               explicit_hartids;
   cfg_arg_t<bool>                    real_time_clint;
   reg_t                              trigger_count;
+  bool                               jit;
+  bool                               fuse;
+  bool                               skip_idle;
+  size_t                             threads;
+  std::optional<size_t>              quantum;
+  bool                               deterministic;
+  size_t                             tlb_sets;
+  size_t                             tlb_ways;
+  bool                               tlb_stats;
 
   size_t nprocs() const { return hartids().size(); }
   size_t max_hartid() const { return hartids().back(); }
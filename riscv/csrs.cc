@@ -437,7 +437,7 @@ void base_status_csr_t::maybe_flush_tlb(const reg_t newval) noexcept {
       (MSTATUS_MPP | MSTATUS_MPRV
        | (has_page ? (MSTATUS_MXR | MSTATUS_SUM) : 0)
       ))
-    proc->get_mmu()->flush_tlb();
+    proc->get_mmu()->switch_tlb_context();
 }
 
 namespace {
@@ -690,6 +690,10 @@ bool misa_csr_t::unlogged_write(const reg_t val) noexcept {
     }
   }
 
+  // translated code may depend on which extensions are enabled
+  if (new_misa != old_misa)
+    proc->get_mmu()->flush_icache();
+
   return basic_csr_t::unlogged_write(new_misa);
 }
 
@@ -709,10 +713,19 @@ reg_t mip_or_mie_csr_t::read() const noexcept {
 }
 
 void mip_or_mie_csr_t::write_with_mask(const reg_t mask, const reg_t val) noexcept {
-  this->val = (this->val & ~mask) | (val & mask);
+  update_with_mask(mask, val);
   log_write();
 }
 
+// Devices and other harts may set bits in mip from other host threads, so
+// update the bits atomically.
+void mip_or_mie_csr_t::update_with_mask(const reg_t mask, const reg_t val) noexcept {
+  reg_t old = __atomic_load_n(&this->val, __ATOMIC_RELAXED);
+  while (!__atomic_compare_exchange_n(&this->val, &old, (old & ~mask) | (val & mask),
+                                      true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    ;
+}
+
 bool mip_or_mie_csr_t::unlogged_write(const reg_t val) noexcept {
   write_with_mask(write_mask(), val);
   return false; // avoid double logging: already logged by write_with_mask()
@@ -723,7 +736,7 @@ mip_csr_t::mip_csr_t(processor_t* const proc, const reg_t addr):
 }
 
 void mip_csr_t::backdoor_write_with_mask(const reg_t mask, const reg_t val) noexcept {
-  this->val = (this->val & ~mask) | (val & mask);
+  update_with_mask(mask, val);
 }
 
 reg_t mip_csr_t::write_mask() const noexcept {
@@ -928,7 +941,7 @@ base_atp_csr_t::base_atp_csr_t(processor_t* const proc, const reg_t addr):
 bool base_atp_csr_t::unlogged_write(const reg_t val) noexcept {
   const reg_t newval = proc->supports_impl(IMPL_MMU) ? compute_new_satp(val) : 0;
   if (newval != read())
-    proc->get_mmu()->flush_tlb();
+    proc->get_mmu()->switch_tlb_context();
   return basic_csr_t::unlogged_write(newval);
 }
 
@@ -1169,7 +1182,7 @@ void hgatp_csr_t::verify_permissions(insn_t insn, bool write) const {
 }
 
 bool hgatp_csr_t::unlogged_write(const reg_t val) noexcept {
-  proc->get_mmu()->flush_tlb();
+  proc->get_mmu()->switch_tlb_context();
 
   reg_t mask;
   if (proc->get_const_xlen() == 32) {
@@ -207,11 +207,16 @@ static inline bool is_aligned(const unsigned val, const unsigned pos)
        STATE.pc = __npc; \
      } while (0)
 
-class wait_for_interrupt_t {};
-
 #define wfi() \
   do { set_pc_and_serialize(npc); \
-       throw wait_for_interrupt_t(); \
+       npc = PC_WAIT_FOR_INTERRUPT; \
+     } while (0)
+
+// Take trap t once the instruction's routine returns, without unwinding
+// the stack.  The routine must not change architectural state afterwards.
+#define raise_trap(t) \
+  do { p->set_pending_trap(t); \
+       npc = PC_TRAP; \
      } while (0)
 
 #define serialize() set_pc_and_serialize(npc)
@@ -219,6 +224,8 @@ class wait_for_interrupt_t {};
 /* Sentinel PC values to serialize simulator pipeline */
 #define PC_SERIALIZE_BEFORE 3
 #define PC_SERIALIZE_AFTER 5
+#define PC_TRAP 7 /* take the processor's pending trap */
+#define PC_WAIT_FOR_INTERRUPT 9
 #define invalid_pc(pc) ((pc) & 1)
 
 /* Convenience wrappers to simplify softfloat code sequences */
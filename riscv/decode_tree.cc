@@ -0,0 +1,83 @@
+// See LICENSE for license details.
+
+#include "decode_tree.h"
+#include <cassert>
+
+// Nodes at least this small become leaves.
+static const size_t LEAF_SIZE = 3;
+static const unsigned MAX_DEPTH = 8;
+static const unsigned MAX_WIDTH = 8;
+
+void decode_tree_t::build(const std::vector<pattern_t>& patterns)
+{
+  assert(!patterns.empty() && patterns.back().mask == 0);
+
+  this->patterns = patterns;
+  nodes.clear();
+  leaves.clear();
+
+  std::vector<uint32_t> all;
+  for (size_t i = 0; i < patterns.size(); i++)
+    all.push_back(i);
+
+  nodes.resize(1);
+  build_node(0, all, 0, 0);
+}
+
+void decode_tree_t::build_node(size_t node, const std::vector<uint32_t>& candidates,
+                               insn_bits_t known, unsigned depth)
+{
+  // Pick the field that leaves the fewest candidates per child on average,
+  // assuming field values are equally likely, with a charge for table size.
+  unsigned best_shift = 0, best_width = 0;
+  double best_cost = candidates.size();
+
+  if (candidates.size() > LEAF_SIZE && depth < MAX_DEPTH) {
+    // bits already used to reach this node no longer tell candidates apart
+    insn_bits_t used = 0;
+    for (auto i : candidates)
+      used |= patterns[i].mask;
+    used &= ~known;
+
+    for (unsigned width = 1; width <= MAX_WIDTH; width++) {
+      for (unsigned shift = 0; shift + width <= 8 * sizeof(insn_bits_t); shift++) {
+        // a field with an unused bit at either end is no better than a
+        // narrower one
+        if (!((used >> shift) & 1) || !((used >> (shift + width - 1)) & 1))
+          continue;
+
+        insn_bits_t field = ((insn_bits_t(1) << width) - 1) << shift;
+        double cost = double(1 << width) / 64;
+        for (auto i : candidates)
+          cost += 1.0 / (1 << __builtin_popcountll(patterns[i].mask & used & field));
+        if (cost < best_cost) {
+          best_cost = cost;
+          best_shift = shift;
+          best_width = width;
+        }
+      }
+    }
+  }
+
+  if (best_width == 0) {
+    nodes[node] = {0, 0, uint32_t(leaves.size())};
+    leaves.insert(leaves.end(), candidates.begin(), candidates.end());
+    return;
+  }
+
+  size_t first_child = nodes.size();
+  nodes[node] = {uint8_t(best_shift), uint8_t(best_width), uint32_t(first_child)};
+  nodes.resize(first_child + (1 << best_width));
+
+  insn_bits_t field = ((insn_bits_t(1) << best_width) - 1) << best_shift;
+  for (insn_bits_t value = 0; value < (insn_bits_t(1) << best_width); value++) {
+    // keep the candidates whose fixed bits in the field agree with value
+    std::vector<uint32_t> child;
+    for (auto i : candidates) {
+      const pattern_t& p = patterns[i];
+      if (((value << best_shift) & p.mask & field) == (p.match & p.mask & field))
+        child.push_back(i);
+    }
+    build_node(first_child + value, child, known | field, depth + 1);
+  }
+}
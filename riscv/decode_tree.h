@@ -0,0 +1,50 @@
+// See LICENSE for license details.
+#ifndef _RISCV_DECODE_TREE_H
+#define _RISCV_DECODE_TREE_H
+
+#include "decode.h"
+#include <vector>
+
+// Finds the first of an ordered list of (match, mask) patterns satisfied by
+// an instruction in a bounded number of table lookups.  Inner nodes index a
+// table of children with a contiguous field of the instruction bits; leaves
+// hold, in their original order, the few patterns that field values seen so
+// far have not ruled out.  The last pattern must match every instruction.
+class decode_tree_t
+{
+public:
+  struct pattern_t {
+    insn_bits_t match;
+    insn_bits_t mask;
+  };
+
+  void build(const std::vector<pattern_t>& patterns);
+
+  // index of the first pattern that bits satisfy
+  size_t lookup(insn_bits_t bits) const
+  {
+    const node_t* node = &nodes[0];
+    while (node->width != 0)
+      node = &nodes[node->index + ((bits >> node->shift) & ((1 << node->width) - 1))];
+
+    for (const uint32_t* p = &leaves[node->index]; ; p++)
+      if ((bits & patterns[*p].mask) == patterns[*p].match)
+        return *p;
+  }
+
+private:
+  struct node_t {
+    uint8_t shift;
+    uint8_t width;   // 0 for leaves
+    uint32_t index;  // first child in nodes, or first pattern in leaves
+  };
+
+  void build_node(size_t node, const std::vector<uint32_t>& candidates,
+                  insn_bits_t known, unsigned depth);
+
+  std::vector<pattern_t> patterns;
+  std::vector<node_t> nodes;
+  std::vector<uint32_t> leaves;
+};
+
+#endif
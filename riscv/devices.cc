@@ -1,6 +1,14 @@
 #include "devices.h"
 #include "mmu.h"
+#include <algorithm>
 #include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <string>
 
 mmio_device_map_t& mmio_device_map()
 {
@@ -16,56 +24,128 @@ void bus_t::add_device(reg_t addr, abstract_device_t* dev)
   // iteration over this sort, which it does. (python's
   // SortedDict is a good analogy)
   devices[addr] = dev;
+
+  // Devices are added while the simulation is set up, so the table of
+  // regions that accesses search is simply rebuilt from the map.
+  regions.clear();
+  for (auto [base, device] : devices) {
+    auto mem = dynamic_cast<abstract_mem_t*>(device);
+    regions.push_back({base, device, mem, mem ? mem->size() : 0});
+  }
+  last_region = 0;
 }
 
-bool bus_t::load(reg_t addr, size_t len, uint8_t* bytes)
+const bus_t::region_t* bus_t::find_region(reg_t addr)
 {
+  // Accesses tend to go where the last one did, so try that region first.
+  size_t i = last_region.load(std::memory_order_relaxed);
+  if (i < regions.size() && regions[i].base <= addr &&
+      (i + 1 == regions.size() || addr < regions[i + 1].base))
+    return &regions[i];
+
   // Find the device with the base address closest to but
   // less than addr (price-is-right search)
-  auto it = devices.upper_bound(addr);
-  if (devices.empty() || it == devices.begin()) {
-    // Either the bus is empty, or there weren't 
+  auto it = std::upper_bound(regions.begin(), regions.end(), addr,
+                             [](reg_t addr, const region_t& region) { return addr < region.base; });
+  if (it == regions.begin()) {
+    // Either the bus is empty, or there weren't
     // any items with a base address <= addr
-    return false;
+    return NULL;
   }
   // Found at least one item with base address <= addr
   // The iterator points to the device after this, so
   // go back by one item.
   it--;
-  return it->second->load(addr - it->first, len, bytes);
+  last_region.store(it - regions.begin(), std::memory_order_relaxed);
+  return &*it;
+}
+
+bool bus_t::load(reg_t addr, size_t len, uint8_t* bytes)
+{
+  auto region = find_region(addr);
+  return region && region->dev->load(addr - region->base, len, bytes);
 }
 
 bool bus_t::store(reg_t addr, size_t len, const uint8_t* bytes)
 {
-  // See comments in bus_t::load
-  auto it = devices.upper_bound(addr);
-  if (devices.empty() || it == devices.begin()) {
-    return false;
-  }
-  it--;
-  return it->second->store(addr - it->first, len, bytes);
+  auto region = find_region(addr);
+  return region && region->dev->store(addr - region->base, len, bytes);
 }
 
 std::pair<reg_t, abstract_device_t*> bus_t::find_device(reg_t addr)
 {
-  // See comments in bus_t::load
-  auto it = devices.upper_bound(addr);
-  if (devices.empty() || it == devices.begin()) {
+  auto region = find_region(addr);
+  if (!region)
     return std::make_pair((reg_t)0, (abstract_device_t*)NULL);
-  }
-  it--;
-  return std::make_pair(it->first, it->second);
+  return std::make_pair(region->base, region->dev);
+}
+
+std::pair<reg_t, abstract_device_t*> bus_t::find_mmio_device(reg_t addr, reg_t len)
+{
+  auto region = find_region(addr);
+  if (!region || region->mem ||
+      (region + 1 != regions.data() + regions.size() && addr + len > region[1].base))
+    return std::make_pair((reg_t)0, (abstract_device_t*)NULL);
+  return std::make_pair(region->base, region->dev);
 }
 
-mem_t::mem_t(reg_t size)
-  : sz(size)
+std::pair<reg_t, abstract_mem_t*> bus_t::find_mem(reg_t addr)
+{
+  auto region = find_region(addr);
+  if (!region || !region->mem || addr - region->base >= region->mem_size)
+    return std::make_pair((reg_t)0, (abstract_mem_t*)NULL);
+  return std::make_pair(region->base, region->mem);
+}
+
+mem_t::mem_t(reg_t size, bool huge_pages)
+  : data(NULL), sz(size)
 {
   if (size == 0 || size % PGSIZE != 0)
     throw std::runtime_error("memory size must be a positive multiple of 4 KiB");
+
+  // the kernel zero-fills pages as they are first touched
+  if (size == size_t(size)) {
+    void* p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (p != MAP_FAILED)
+      data = (char*)p;
+  }
+
+#ifdef MADV_HUGEPAGE
+  if (data && huge_pages)
+    madvise(data, size, MADV_HUGEPAGE);
+#endif
+}
+
+image_mem_t::image_mem_t(reg_t size, const char* filename)
+  : mem_t(size)
+{
+  int fd = open(filename, O_RDONLY);
+  if (fd == -1)
+    throw std::runtime_error(std::string("can't open memory image ") + filename + ": " + strerror(errno));
+
+  struct stat s;
+  if (fstat(fd, &s) == -1 || !S_ISREG(s.st_mode)) {
+    close(fd);
+    throw std::runtime_error(std::string("memory image ") + filename + " isn't a regular file");
+  }
+  if (reg_t(s.st_size) > size) {
+    close(fd);
+    throw std::runtime_error(std::string("memory image ") + filename + " is larger than its memory region");
+  }
+
+  if (!data || (s.st_size != 0 &&
+                mmap(data, s.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED)) {
+    close(fd);
+    throw std::runtime_error(std::string("can't map memory image ") + filename);
+  }
+  close(fd);
 }
 
 mem_t::~mem_t()
 {
+  if (data)
+    munmap(data, sz);
   for (auto& entry : sparse_memory_map)
     free(entry.second);
 }
@@ -75,6 +155,14 @@ bool mem_t::load_store(reg_t addr, size_t len, uint8_t* bytes, bool store)
   if (addr + len < addr || addr + len > sz)
     return false;
 
+  if (data) {
+    if (store)
+      memcpy(data + addr, bytes, len);
+    else
+      memcpy(bytes, data + addr, len);
+    return true;
+  }
+
   while (len > 0) {
     auto n = std::min(PGSIZE - (addr % PGSIZE), reg_t(len));
 
@@ -92,7 +180,11 @@ bool mem_t::load_store(reg_t addr, size_t len, uint8_t* bytes, bool store)
 }
 
 char* mem_t::contents(reg_t addr) {
+  if (data)
+    return data + addr;
+
   reg_t ppn = addr >> PGSHIFT, pgoff = addr % PGSIZE;
+  std::lock_guard<std::mutex> guard(sparse_memory_map_lock);
   auto search = sparse_memory_map.find(ppn);
   if (search == sparse_memory_map.end()) {
     auto res = (char*)calloc(PGSIZE, 1);
@@ -105,6 +197,11 @@ char* mem_t::contents(reg_t addr) {
 }
 
 void mem_t::dump(std::ostream& o) {
+  if (data) {
+    o.write(data, sz);
+    return;
+  }
+
   const char empty[PGSIZE] = {0};
   for (reg_t i = 0; i < sz; i += PGSIZE) {
     reg_t ppn = i >> PGSHIFT;
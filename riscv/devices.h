@@ -5,7 +5,9 @@
 #include "abstract_device.h"
 #include "abstract_interrupt_controller.h"
 #include "platform.h"
+#include <atomic>
 #include <map>
+#include <mutex>
 #include <queue>
 #include <vector>
 #include <utility>
@@ -13,6 +15,7 @@
 
 class processor_t;
 class simif_t;
+class abstract_mem_t;
 
 class bus_t : public abstract_device_t {
  public:
@@ -21,9 +24,25 @@ class bus_t : public abstract_device_t {
   void add_device(reg_t addr, abstract_device_t* dev);
 
   std::pair<reg_t, abstract_device_t*> find_device(reg_t addr);
+  // the memory holding addr, if it is memory, and its base
+  std::pair<reg_t, abstract_mem_t*> find_mem(reg_t addr);
+  // the device, other than a memory, serving all of [addr, addr + len), and its base
+  std::pair<reg_t, abstract_device_t*> find_mmio_device(reg_t addr, reg_t len);
 
  private:
+  // A device serves the addresses from its base up to the next device's.
+  // Memories are noted when added, so they can be told apart cheaply.
+  struct region_t {
+    reg_t base;
+    abstract_device_t* dev;
+    abstract_mem_t* mem;
+    reg_t mem_size;
+  };
+  const region_t* find_region(reg_t addr);
+
   std::map<reg_t, abstract_device_t*> devices;
+  std::vector<region_t> regions; // one per device, sorted by base
+  std::atomic<size_t> last_region{0}; // where the last search ended
 };
 
 class rom_device_t : public abstract_device_t {
@@ -47,7 +66,8 @@ class abstract_mem_t : public abstract_device_t {
 
 class mem_t : public abstract_mem_t {
  public:
-  mem_t(reg_t size);
+  // huge_pages asks the host to back the memory with transparent huge pages
+  mem_t(reg_t size, bool huge_pages = false);
   mem_t(const mem_t& that) = delete;
   ~mem_t() override;
 
@@ -57,11 +77,25 @@ class mem_t : public abstract_mem_t {
   reg_t size() override { return sz; }
   void dump(std::ostream& o) override;
 
+ protected:
+  // All of the memory, mapped on demand by the host, or NULL if the host
+  // couldn't reserve that much address space, in which case pages are
+  // allocated one by one in sparse_memory_map.
+  char* data;
+  std::map<reg_t, char*> sparse_memory_map;
+  std::mutex sparse_memory_map_lock; // pages are allocated by concurrent harts
+  reg_t sz;
+
  private:
   bool load_store(reg_t addr, size_t len, uint8_t* bytes, bool store);
+};
 
-  std::map<reg_t, char*> sparse_memory_map;
-  reg_t sz;
+// Memory that starts out holding the contents of a file, mapped copy-on-write
+// so that nothing is copied up front, and simulations of the same image share
+// the host's page cache until they write to it.  The rest is zeroed.
+class image_mem_t : public mem_t {
+ public:
+  image_mem_t(reg_t size, const char* filename);
 };
 
 class clint_t : public abstract_device_t {
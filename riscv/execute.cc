@@ -3,6 +3,7 @@
 #include "config.h"
 #include "processor.h"
 #include "mmu.h"
+#include "jit.h"
 #include "disasm.h"
 #include "decode_macros.h"
 #include <cassert>
@@ -173,16 +174,11 @@ static inline reg_t execute_insn_logged(processor_t* p, reg_t pc, insn_fetch_t f
 
   try {
     npc = fetch.func(p, fetch.insn, pc);
-    if (npc != PC_SERIALIZE_BEFORE) {
+    if (npc != PC_SERIALIZE_BEFORE && npc != PC_TRAP) {
       if (p->get_log_commits_enabled()) {
         commit_log_print_insn(p, pc, fetch.insn);
       }
      }
-  } catch (wait_for_interrupt_t &t) {
-      if (p->get_log_commits_enabled()) {
-        commit_log_print_insn(p, pc, fetch.insn);
-      }
-      throw;
   } catch(mem_trap_t& t) {
       //handle segfault in midlle of vector load/store
       if (p->get_log_commits_enabled()) {
@@ -197,7 +193,8 @@ static inline reg_t execute_insn_logged(processor_t* p, reg_t pc, insn_fetch_t f
   } catch(...) {
     throw;
   }
-  p->update_histogram(pc);
+  if (npc != PC_TRAP && npc != PC_WAIT_FOR_INTERRUPT)
+    p->update_histogram(pc);
 
   return npc;
 }
@@ -205,7 +202,21 @@ static inline reg_t execute_insn_logged(processor_t* p, reg_t pc, insn_fetch_t f
 bool processor_t::slow_path()
 {
   return debug || state.single_step != state.STEP_NONE || state.debug_mode ||
-         log_commits_enabled || histogram_enabled || in_wfi || check_triggers_icount;
+         in_wfi || check_triggers_icount;
+}
+
+void processor_t::deliver_trap(trap_t& t, reg_t epc)
+{
+  take_trap(t, epc);
+
+  // Trigger action takes priority over single step
+  auto match = TM.detect_trap_match(t);
+  if (match.has_value())
+    take_trigger_action(match->action, 0, state.pc, 0);
+  else if (unlikely(state.single_step == state.STEP_STEPPED)) {
+    state.single_step = state.STEP_NONE;
+    enter_debug_mode(DCSR_CAUSE_STEP);
+  }
 }
 
 // fetch/decode/execute loop
@@ -229,11 +240,17 @@ void processor_t::step(size_t n)
     state.prv_changed = false;
     state.v_changed = false;
 
+    // A WFI returns to the outer simulation loop, which gives other
+    // devices/harts a chance to generate interrupts.  In the debug ROM this
+    // prevents us from wasting time looping, but also allows us to switch to
+    // other threads only once per idle loop in case there is activity.
     #define advance_pc() \
       if (unlikely(invalid_pc(pc))) { \
         switch (pc) { \
           case PC_SERIALIZE_BEFORE: state.serialized = true; break; \
           case PC_SERIALIZE_AFTER: ++instret; break; \
+          case PC_TRAP: take_pending_trap(state.pc); n = instret; break; \
+          case PC_WAIT_FOR_INTERRUPT: n = ++instret; in_wfi = true; break; \
           default: abort(); \
         } \
         pc = state.pc; \
@@ -275,7 +292,8 @@ void processor_t::step(size_t n)
 
           // debug mode wfis must nop
           if (unlikely(in_wfi && !state.debug_mode)) {
-            throw wait_for_interrupt_t();
+            n = ++instret;
+            break;
           }
 
           in_wfi = false;
@@ -286,37 +304,84 @@ void processor_t::step(size_t n)
           advance_pc();
         }
       }
+      else if (unlikely(log_commits_enabled || histogram_enabled))
+      {
+        // Main simulation loop, logging path.  Instructions come from the
+        // block cache, as in the fast path, but each one is logged and
+        // brings state.pc up to date as it retires.
+        insn_block_t* block = NULL;
+        size_t i = 0;
+        while (instret < n)
+        {
+          if (block == NULL || i == block->length) {
+            block = _mmu->access_block_cache(pc);
+            i = 0;
+          }
+
+          pc = execute_insn_logged(this, pc, block->insns[i++]);
+          advance_pc();
+        }
+      }
       else while (instret < n)
       {
         // Main simulation loop, fast path.
-        for (auto ic_entry = _mmu->access_icache(pc); ; ) {
-          auto fetch = ic_entry->data;
-          pc = execute_insn_fast(this, pc, fetch);
-          ic_entry = ic_entry->next;
-          if (unlikely(ic_entry->tag != pc))
-            break;
-          if (unlikely(instret + 1 == n))
-            break;
+        // Only the last instruction of a block can serialize or observe
+        // state.pc, so state.pc need only be brought up to date before it.
+        auto block = _mmu->access_block_cache(pc);
+        size_t length = std::min<reg_t>(block->length, n - instret);
+        size_t i = 0;
+
+        if (unlikely(jit != NULL) && length == block->length) {
+          if (block->jit) {
+            i = block->jit(const_cast<reg_t*>(&state.XPR[0]));
+            for (size_t j = 0; j < i; j++)
+              pc += block->insns[j].insn.length();
+            instret += i;
+          } else if (++block->executions == jit_t::HOT_THRESHOLD) {
+            jit->compile(block, pc);
+          }
+        }
+
+        if (unlikely(block->fusions != 0) && length == block->length) {
+          // A fused pair whose second instruction isn't the last of the
+          // block may have executed only its first (see fusion.h).
+          for (; i + 2 < length; i++) {
+            if (block->fused[i] == NULL) {
+              pc = execute_insn_fast(this, pc, block->insns[i]);
+            } else {
+              reg_t second_pc = pc + block->insns[i].insn.length();
+              pc = block->fused[i](this, &block->insns[i], pc);
+              if (pc != second_pc) {
+                i++;
+                instret++;
+              }
+            }
+            instret++;
+          }
+
+          if (i + 2 == length && block->fused[i] != NULL) {
+            state.pc = pc;
+            pc = block->fused[i](this, &block->insns[i], pc);
+            instret++;
+            advance_pc();
+            continue;
+          }
+        }
+
+        for (; i + 1 < length; i++) {
+          pc = execute_insn_fast(this, pc, block->insns[i]);
           instret++;
-          state.pc = pc;
         }
 
+        state.pc = pc;
+        pc = execute_insn_fast(this, pc, block->insns[length - 1]);
         advance_pc();
       }
     }
     catch(trap_t& t)
     {
-      take_trap(t, pc);
+      deliver_trap(t, pc);
       n = instret;
-
-      // Trigger action takes priority over single step
-      auto match = TM.detect_trap_match(t);
-      if (match.has_value())
-        take_trigger_action(match->action, 0, state.pc, 0);
-      else if (unlikely(state.single_step == state.STEP_STEPPED)) {
-        state.single_step = state.STEP_NONE;
-        enter_debug_mode(DCSR_CAUSE_STEP);
-      }
     }
     catch (triggers::matched_t& t)
     {
@@ -330,16 +395,11 @@ void processor_t::step(size_t n)
     {
       enter_debug_mode(DCSR_CAUSE_SWBP);
     }
-    catch (wait_for_interrupt_t &t)
+    catch (defer_access_t&)
     {
-      // Return to the outer simulation loop, which gives other devices/harts a
-      // chance to generate interrupts.
-      //
-      // In the debug ROM this prevents us from wasting time looping, but also
-      // allows us to switch to other threads only once per idle loop in case
-      // there is activity.
-      n = ++instret;
-      in_wfi = true;
+      // sim_t reruns the instruction once the other harts have stopped
+      state.pc = pc;
+      n = instret;
     }
 
     state.minstret->bump(instret);
@@ -0,0 +1,186 @@
+// See LICENSE for license details.
+
+#include "fusion.h"
+#include "processor.h"
+#include "decode_macros.h"
+
+#define FUSED_INSNS \
+  X(lui) X(auipc) X(addi) X(addiw) X(slli) X(srli) X(lw) X(ld) \
+  X(slt) X(sltu) X(slti) X(sltiu) X(beq) X(bne) X(jalr)
+
+// Instructions are recognized by the interpreter routine they decode to,
+// so only the RV32I and RV64I (not RV32E/RV64E), non-logging variants match.
+#define X(name) \
+  extern reg_t fast_rv32i_##name(processor_t*, insn_t, reg_t); \
+  extern reg_t fast_rv64i_##name(processor_t*, insn_t, reg_t);
+FUSED_INSNS
+#undef X
+
+// None of the fused instructions is compressed, and fuse_pair() doesn't
+// fuse pairs whose addresses wrap, so their addresses are pc, pc + 4 and
+// pc + 8 without sign extension.
+
+// lui rd, imm; addi rd, rd, imm
+template<int xlen>
+static reg_t fused_lui_addi(processor_t* p, const insn_fetch_t* insns, reg_t pc)
+{
+  insn_t lui = insns[0].insn, addi = insns[1].insn;
+  STATE.XPR.write(addi.rd(), sext_xlen(lui.u_imm() + addi.i_imm()));
+  return pc + 8;
+}
+
+// lui rd, imm; addiw rd, rd, imm
+static reg_t fused_lui_addiw(processor_t* p, const insn_fetch_t* insns, reg_t pc)
+{
+  insn_t lui = insns[0].insn, addiw = insns[1].insn;
+  STATE.XPR.write(addiw.rd(), sext32(lui.u_imm() + addiw.i_imm()));
+  return pc + 8;
+}
+
+// auipc rd, imm; addi rd, rd, imm
+template<int xlen>
+static reg_t fused_auipc_addi(processor_t* p, const insn_fetch_t* insns, reg_t pc)
+{
+  insn_t auipc = insns[0].insn, addi = insns[1].insn;
+  STATE.XPR.write(addi.rd(), sext_xlen(auipc.u_imm() + pc + addi.i_imm()));
+  return pc + 8;
+}
+
+// slli rd, rs1, shamt; srli rd, rd, shamt
+template<int xlen>
+static reg_t fused_slli_srli(processor_t* p, const insn_fetch_t* insns, reg_t pc)
+{
+  insn_t slli = insns[0].insn, srli = insns[1].insn;
+  reg_t shamt = slli.i_imm() & 0x3F;
+  STATE.XPR.write(srli.rd(), sext_xlen(zext_xlen(STATE.XPR[slli.rs1()] << shamt) >> shamt));
+  return pc + 8;
+}
+
+// auipc rd, imm; lw/ld rd2, imm(rd)
+template<int xlen, typename T>
+static reg_t fused_auipc_load(processor_t* p, const insn_fetch_t* insns, reg_t pc)
+{
+  insn_t auipc = insns[0].insn, load = insns[1].insn;
+  reg_t base = sext_xlen(auipc.u_imm() + pc);
+  STATE.XPR.write(auipc.rd(), base);
+
+  // leave loads that might trap to the load's own routine
+  T value;
+  if (!p->get_mmu()->load_fast(base + load.i_imm(), &value))
+    return pc + 4;
+
+  STATE.XPR.write(load.rd(), value);
+  return pc + 8;
+}
+
+template<int xlen> static reg_t slt(processor_t* p, insn_t insn) { return sreg_t(STATE.XPR[insn.rs1()]) < sreg_t(STATE.XPR[insn.rs2()]); }
+template<int xlen> static reg_t sltu(processor_t* p, insn_t insn) { return STATE.XPR[insn.rs1()] < STATE.XPR[insn.rs2()]; }
+template<int xlen> static reg_t slti(processor_t* p, insn_t insn) { return sreg_t(STATE.XPR[insn.rs1()]) < sreg_t(insn.i_imm()); }
+template<int xlen> static reg_t sltiu(processor_t* p, insn_t insn) { return STATE.XPR[insn.rs1()] < reg_t(insn.i_imm()); }
+
+// slt/sltu/slti/sltiu rd, ...; beq/bne rd, zero, offset
+template<int xlen, reg_t (*compare)(processor_t*, insn_t), bool bne>
+static reg_t fused_compare_branch(processor_t* p, const insn_fetch_t* insns, reg_t pc)
+{
+  insn_t cmp = insns[0].insn, branch = insns[1].insn;
+  reg_t value = compare(p, cmp);
+  STATE.XPR.write(cmp.rd(), value);
+  if ((value != 0) == bne)
+    return sext_xlen(pc + 4 + branch.sb_imm());
+  return pc + 8;
+}
+
+// auipc rd, imm; jalr rd2, imm(rd)
+template<int xlen>
+static reg_t fused_auipc_jalr(processor_t* p, const insn_fetch_t* insns, reg_t pc)
+{
+  insn_t auipc = insns[0].insn, jalr = insns[1].insn;
+  reg_t base = sext_xlen(auipc.u_imm() + pc);
+  STATE.XPR.write(auipc.rd(), base);
+  reg_t target = sext_xlen((base + jalr.i_imm()) & ~reg_t(1));
+  STATE.XPR.write(jalr.rd(), pc + 8);
+  return target;
+}
+
+// the handler for the pair of instructions at pc and pc + 4, if any.  last
+// is set if the second instruction is the last of its block.
+template<int xlen>
+static fused_func_t fuse_pair(processor_t* p, const insn_fetch_t* insns, reg_t pc, bool last)
+{
+  #define IS(fetch, name) ((fetch).func == (xlen == 64 ? fast_rv64i_##name : fast_rv32i_##name))
+
+  insn_fetch_t a = insns[0];
+  insn_fetch_t b = insns[1];
+  reg_t rd = a.insn.rd();
+
+  if (rd == 0 || reg_t(sext_xlen(pc + 8)) != pc + 8)
+    return NULL;
+
+  // the second instruction must consume the result of the first
+  if (b.insn.rs1() != rd)
+    return NULL;
+  bool overwrites = b.insn.rd() == rd;
+
+  if (IS(a, lui) && IS(b, addi) && overwrites)
+    return fused_lui_addi<xlen>;
+  if (xlen == 64 && IS(a, lui) && IS(b, addiw) && overwrites)
+    return fused_lui_addiw;
+  if (IS(a, auipc) && IS(b, addi) && overwrites)
+    return fused_auipc_addi<xlen>;
+  if (IS(a, slli) && IS(b, srli) && overwrites &&
+      (a.insn.i_imm() & 0x3F) == (b.insn.i_imm() & 0x3F) && (a.insn.i_imm() & 0x3F) < xlen)
+    return fused_slli_srli<xlen>;
+
+  // a pair that might run only its first instruction mustn't end the block
+  if (IS(a, auipc) && IS(b, lw) && !last)
+    return fused_auipc_load<xlen, int32_t>;
+  if (xlen == 64 && IS(a, auipc) && IS(b, ld) && !last)
+    return fused_auipc_load<xlen, int64_t>;
+
+  // with IALIGN=16, no target of a branch or jalr is misaligned, so these
+  // never trap.  (Clearing misa.C flushes the blocks.)
+  if (!p->extension_enabled(EXT_ZCA))
+    return NULL;
+
+  if (IS(a, auipc) && IS(b, jalr))
+    return fused_auipc_jalr<xlen>;
+
+  if (b.insn.rs2() != 0 || !(IS(b, beq) || IS(b, bne)))
+    return NULL;
+
+  #define COMPARE_BRANCH(name) \
+    if (IS(a, name)) \
+      return IS(b, bne) ? fused_compare_branch<xlen, name<xlen>, true> \
+                        : fused_compare_branch<xlen, name<xlen>, false>;
+  COMPARE_BRANCH(slt)
+  COMPARE_BRANCH(sltu)
+  COMPARE_BRANCH(slti)
+  COMPARE_BRANCH(sltiu)
+  #undef COMPARE_BRANCH
+
+  #undef IS
+  return NULL;
+}
+
+void fuse_block(processor_t* p, insn_block_t* block)
+{
+  // the fused routines don't check register numbers against RVE's limit
+  if (p->extension_enabled('E'))
+    return;
+
+  reg_t pc = block->tag;
+  for (size_t i = 0; i + 1 < block->length; ) {
+    bool last = i + 2 == block->length;
+    fused_func_t fused = p->get_xlen() == 64 ? fuse_pair<64>(p, &block->insns[i], pc, last)
+                                             : fuse_pair<32>(p, &block->insns[i], pc, last);
+    if (fused) {
+      block->fused[i] = fused;
+      block->fusions++;
+      pc += 8;
+      i += 2;
+    } else {
+      pc += block->insns[i].insn.length();
+      i++;
+    }
+  }
+}
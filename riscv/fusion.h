@@ -0,0 +1,19 @@
+// See LICENSE for license details.
+#ifndef _RISCV_FUSION_H
+#define _RISCV_FUSION_H
+
+#include "mmu.h"
+
+class processor_t;
+
+// Finds pairs of adjacent instructions in a block that the fast path can
+// execute with a single handler, and records the handler for each pair in
+// block->fused at the index of its first instruction.
+//
+// A fused pair behaves exactly as its two instructions would.  A handler
+// whose second instruction could trap executes only the first instruction
+// when it cannot rule the trap out, and then returns the address of the
+// second; pairs that end the block never trap.
+void fuse_block(processor_t* p, insn_block_t* block);
+
+#endif
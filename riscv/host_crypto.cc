@@ -0,0 +1,58 @@
+// See LICENSE for license details.
+
+#include "config.h"
+#include "host_crypto.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define HOST_CRYPTO_X86_64
+#include <immintrin.h>
+#endif
+
+#ifdef HOST_CRYPTO_X86_64
+
+static bool host_has_aes()
+{
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("aes");
+}
+
+static const bool have_aes = host_has_aes();
+
+__attribute__((target("aes")))
+static void aesni_round(uint8_t* state, const uint8_t* round_key,
+                        host_aes_round_t round)
+{
+  __m128i s = _mm_loadu_si128((const __m128i*)state);
+  __m128i k = _mm_loadu_si128((const __m128i*)round_key);
+
+  switch (round) {
+    case HOST_AES_ENC_MIDDLE: s = _mm_aesenc_si128(s, k); break;
+    case HOST_AES_ENC_FINAL: s = _mm_aesenclast_si128(s, k); break;
+    // AESDEC adds the round key after InvMixColumns rather than before it,
+    // but InvMixColumns is linear, so passing it a transformed key is
+    // equivalent.
+    case HOST_AES_DEC_MIDDLE: s = _mm_aesdec_si128(s, _mm_aesimc_si128(k)); break;
+    case HOST_AES_DEC_FINAL: s = _mm_aesdeclast_si128(s, k); break;
+  }
+
+  _mm_storeu_si128((__m128i*)state, s);
+}
+
+bool host_aes_round(uint8_t* state, const uint8_t* round_key,
+                    host_aes_round_t round)
+{
+  if (!have_aes)
+    return false;
+
+  aesni_round(state, round_key, round);
+  return true;
+}
+
+#else
+
+bool host_aes_round(uint8_t*, const uint8_t*, host_aes_round_t)
+{
+  return false;
+}
+
+#endif
@@ -0,0 +1,23 @@
+// See LICENSE for license details.
+#ifndef _RISCV_HOST_CRYPTO_H
+#define _RISCV_HOST_CRYPTO_H
+
+#include <stdint.h>
+
+// Fast paths for the vector crypto instructions built on the host's own
+// crypto instructions.  Whether the host has them is probed once at
+// startup; each function returns false, leaving its operands untouched,
+// when it doesn't, and the caller then uses the portable implementation.
+
+enum host_aes_round_t {
+  HOST_AES_ENC_MIDDLE,  // SubBytes, ShiftRows, MixColumns, AddRoundKey
+  HOST_AES_ENC_FINAL,   // SubBytes, ShiftRows, AddRoundKey
+  HOST_AES_DEC_MIDDLE,  // InvShiftRows, InvSubBytes, AddRoundKey, InvMixColumns
+  HOST_AES_DEC_FINAL,   // InvShiftRows, InvSubBytes, AddRoundKey
+};
+
+// Apply one AES round to the 16-byte state, in FIPS-197 byte order.
+bool host_aes_round(uint8_t* state, const uint8_t* round_key,
+                    host_aes_round_t round);
+
+#endif
@@ -1,4 +1,9 @@
 require_extension('H');
 require_novirt();
 require_privilege(get_field(STATE.mstatus->read(), MSTATUS_TVM) ? PRV_M : PRV_S);
-MMU.flush_tlb();
+std::optional<reg_t> gaddr, vmid;
+if (insn.rs1() != 0)
+  gaddr = RS1 << 2;
+if (insn.rs2() != 0)
+  vmid = RS2;
+MMU.flush_tlb_gvma(gaddr, vmid);
@@ -1,4 +1,9 @@
 require_extension('H');
 require_novirt();
 require_privilege(PRV_S);
-MMU.flush_tlb();
+std::optional<reg_t> vaddr, asid;
+if (insn.rs1() != 0)
+  vaddr = RS1;
+if (insn.rs2() != 0)
+  asid = RS2;
+MMU.flush_tlb_vma(true, vaddr, asid);
@@ -6,4 +6,9 @@ if (STATE.v) {
 } else {
   require_privilege(get_field(STATE.mstatus->read(), MSTATUS_TVM) ? PRV_M : PRV_S);
 }
-MMU.flush_tlb();
+std::optional<reg_t> vaddr, asid;
+if (insn.rs1() != 0)
+  vaddr = RS1;
+if (insn.rs2() != 0)
+  asid = RS2;
+MMU.flush_tlb_vma(STATE.v, vaddr, asid);
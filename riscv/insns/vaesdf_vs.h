@@ -28,13 +28,15 @@ VI_ZVK_VD_VS2_NOOPERANDS_PRELOOP_EGU32x4_NOVM_LOOP(
     // macro that defines/extracts the operand variables as EGU32x4.
     EGU8x16_t aes_state = P.VU.elt_group<EGU8x16_t>(vd_num, idx_eg);
 
-    // InvShiftRows - Rotate each row bytes by 0, 1, 2, 3 positions.
-    VAES_INV_SHIFT_ROWS(aes_state);
-    // InvSubBytes - Apply S-box to every byte in the state
-    VAES_INV_SUB_BYTES(aes_state);
-    // AddRoundKey (which is also InvAddRoundKey as it's xor)
-    EGU8x16_XOREQ(aes_state, scalar_key);
-    // InvMixColumns is not performed in the final round.
+    if (!host_aes_round(aes_state.data(), scalar_key.data(), HOST_AES_DEC_FINAL)) {
+      // InvShiftRows - Rotate each row bytes by 0, 1, 2, 3 positions.
+      VAES_INV_SHIFT_ROWS(aes_state);
+      // InvSubBytes - Apply S-box to every byte in the state
+      VAES_INV_SUB_BYTES(aes_state);
+      // AddRoundKey (which is also InvAddRoundKey as it's xor)
+      EGU8x16_XOREQ(aes_state, scalar_key);
+      // InvMixColumns is not performed in the final round.
+    }
 
     // Update the destination register.
     EGU8x16_t &vd = P.VU.elt_group<EGU8x16_t>(vd_num, idx_eg, true);
@@ -22,13 +22,15 @@ VI_ZVK_VD_VS2_NOOPERANDS_PRELOOP_EGU32x4_NOVM_LOOP(
     EGU8x16_t aes_state = P.VU.elt_group<EGU8x16_t>(vd_num, idx_eg);
     const EGU8x16_t round_key = P.VU.elt_group<EGU8x16_t>(vs2_num, idx_eg);
 
-    // SubBytes - Apply S-box to every byte in the state
-    VAES_SUB_BYTES(aes_state);
-    // ShiftRows - Rotate each row bytes by 0, 1, 2, 3 positions.
-    VAES_SHIFT_ROWS(aes_state);
-    // MixColumns is not performed for the final round.
-    // AddRoundKey
-    EGU8x16_XOREQ(aes_state, round_key);
+    if (!host_aes_round(aes_state.data(), round_key.data(), HOST_AES_ENC_FINAL)) {
+      // SubBytes - Apply S-box to every byte in the state
+      VAES_SUB_BYTES(aes_state);
+      // ShiftRows - Rotate each row bytes by 0, 1, 2, 3 positions.
+      VAES_SHIFT_ROWS(aes_state);
+      // MixColumns is not performed for the final round.
+      // AddRoundKey
+      EGU8x16_XOREQ(aes_state, round_key);
+    }
 
     // Update the destination register.
     EGU8x16_t &vd = P.VU.elt_group<EGU8x16_t>(vd_num, idx_eg, true);
@@ -28,14 +28,16 @@ VI_ZVK_VD_VS2_NOOPERANDS_PRELOOP_EGU32x4_NOVM_LOOP(
     // macro that defines/extracts the operand variables as EGU32x4.
     EGU8x16_t aes_state = P.VU.elt_group<EGU8x16_t>(vd_num, idx_eg);
 
-    // SubBytes - Apply S-box to every byte in the state
-    VAES_SUB_BYTES(aes_state);
-    // ShiftRows - Rotate each row bytes by 0, 1, 2, 3 positions.
-    VAES_SHIFT_ROWS(aes_state);
-    // MixColumns
-    VAES_MIX_COLUMNS(aes_state);
-    // AddRoundKey
-    EGU8x16_XOREQ(aes_state, scalar_key);
+    if (!host_aes_round(aes_state.data(), scalar_key.data(), HOST_AES_ENC_MIDDLE)) {
+      // SubBytes - Apply S-box to every byte in the state
+      VAES_SUB_BYTES(aes_state);
+      // ShiftRows - Rotate each row bytes by 0, 1, 2, 3 positions.
+      VAES_SHIFT_ROWS(aes_state);
+      // MixColumns
+      VAES_MIX_COLUMNS(aes_state);
+      // AddRoundKey
+      EGU8x16_XOREQ(aes_state, scalar_key);
+    }
 
     // Update the destination register.
     EGU8x16_t &vd = P.VU.elt_group<EGU8x16_t>(vd_num, idx_eg, true);
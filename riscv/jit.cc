@@ -0,0 +1,397 @@
+// See LICENSE for license details.
+
+#include "config.h"
+#include "jit.h"
+#include "processor.h"
+#include <cstddef>
+#include <stdexcept>
+#include <string.h>
+#include <sys/mman.h>
+
+#if defined(__x86_64__) && !defined(_WIN32)
+#define JIT_X86_64
+#endif
+
+// size of the buffer holding translated code; it is recycled when full
+static const size_t CODE_SIZE = 16 << 20;
+
+// host registers
+enum { RAX = 0, RCX = 1, RDX = 2, RSI = 6, RDI = 7, R8 = 8 };
+
+#define JIT_INSNS \
+  X(lui) X(auipc) X(addi) X(slti) X(sltiu) X(xori) X(ori) X(andi) \
+  X(slli) X(srli) X(srai) X(add) X(sub) X(sll) X(slt) X(sltu) X(xor) \
+  X(srl) X(sra) X(or) X(and) X(addiw) X(slliw) X(srliw) X(sraiw) \
+  X(addw) X(subw) X(sllw) X(srlw) X(sraw) X(mul) X(mulw) \
+  X(lb) X(lh) X(lw) X(ld) X(lbu) X(lhu) X(lwu) X(sb) X(sh) X(sw) X(sd) \
+  X(c_addi) X(c_jal) X(c_li) X(c_lui) X(c_mv) X(c_add) X(c_sub) \
+  X(c_xor) X(c_or) X(c_and) X(c_subw) X(c_addw) X(c_andi) X(c_slli) \
+  X(c_srli) X(c_srai) X(c_flw) X(c_lw) X(c_fsw) X(c_sw) X(c_flwsp) \
+  X(c_lwsp) X(c_fswsp) X(c_swsp) X(c_addi4spn)
+
+// Translated instructions are recognized by the interpreter routine they
+// decode to, so only the RV64I (not RV64E), non-logging variants match.
+#define X(name) extern reg_t fast_rv64i_##name(processor_t*, insn_t, reg_t);
+JIT_INSNS
+#undef X
+
+jit_t::jit_t(processor_t* proc)
+  : proc(proc), mmu(proc->get_mmu()), code(NULL), code_used(0)
+{
+  static_assert(sizeof(tlb_entry_t) == 16 && offsetof(tlb_entry_t, host_offset) == 0,
+                "translated loads and stores assume the TLB entry layout");
+
+  void* p = mmap(NULL, CODE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED)
+    throw std::runtime_error("unable to allocate JIT code buffer");
+  code = (uint8_t*)p;
+}
+
+jit_t::~jit_t()
+{
+  munmap(code, CODE_SIZE);
+}
+
+bool jit_t::host_supported()
+{
+#ifdef JIT_X86_64
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool jit_t::translate(insn_fetch_t fetch, reg_t pc, jit_insn_t* out)
+{
+  insn_t insn = fetch.insn;
+  insn_func_t f = fetch.func;
+
+  // The misa bits consulted here are fixed for the lifetime of a block,
+  // since misa writes flush the block cache.
+  bool rvc = proc->extension_enabled(EXT_ZCA);
+  bool mul = proc->extension_enabled('M') || proc->extension_enabled(EXT_ZMMUL);
+  bool mem = !mmu->is_target_big_endian();
+
+  auto reg = [&](op_t op, unsigned rd, unsigned rs1, unsigned rs2) {
+    *out = {op, rd, rs1, rs2, false, 0, 0, false};
+    return true;
+  };
+  auto imm = [&](op_t op, unsigned rd, unsigned rs1, int64_t imm) {
+    *out = {op, rd, rs1, 0, true, imm, 0, false};
+    return true;
+  };
+  auto load = [&](unsigned rd, unsigned rs1, int64_t imm, unsigned size, bool sign) {
+    *out = {OP_LOAD, rd, rs1, 0, true, imm, size, sign};
+    return mem;
+  };
+  auto store = [&](unsigned rs1, unsigned rs2, int64_t imm, unsigned size) {
+    *out = {OP_STORE, 0, rs1, rs2, true, imm, size, false};
+    return mem;
+  };
+
+  if (f == fast_rv64i_lui)   return imm(OP_ADD, insn.rd(), 0, insn.u_imm());
+  if (f == fast_rv64i_auipc) return imm(OP_ADD, insn.rd(), 0, insn.u_imm() + pc);
+  if (f == fast_rv64i_addi)  return imm(OP_ADD, insn.rd(), insn.rs1(), insn.i_imm());
+  if (f == fast_rv64i_slti)  return imm(OP_SLT, insn.rd(), insn.rs1(), insn.i_imm());
+  if (f == fast_rv64i_sltiu) return imm(OP_SLTU, insn.rd(), insn.rs1(), insn.i_imm());
+  if (f == fast_rv64i_xori)  return imm(OP_XOR, insn.rd(), insn.rs1(), insn.i_imm());
+  if (f == fast_rv64i_ori)   return imm(OP_OR, insn.rd(), insn.rs1(), insn.i_imm());
+  if (f == fast_rv64i_andi)  return imm(OP_AND, insn.rd(), insn.rs1(), insn.i_imm());
+  if (f == fast_rv64i_slli)  return imm(OP_SLL, insn.rd(), insn.rs1(), insn.i_imm() & 0x3F);
+  if (f == fast_rv64i_srli)  return imm(OP_SRL, insn.rd(), insn.rs1(), insn.i_imm() & 0x3F);
+  if (f == fast_rv64i_srai)  return imm(OP_SRA, insn.rd(), insn.rs1(), insn.i_imm() & 0x3F);
+  if (f == fast_rv64i_add)   return reg(OP_ADD, insn.rd(), insn.rs1(), insn.rs2());
+  if (f == fast_rv64i_sub)   return reg(OP_SUB, insn.rd(), insn.rs1(), insn.rs2());
+  if (f == fast_rv64i_sll)   return reg(OP_SLL, insn.rd(), insn.rs1(), insn.rs2());
+  if (f == fast_rv64i_slt)   return reg(OP_SLT, insn.rd(), insn.rs1(), insn.rs2());
+  if (f == fast_rv64i_sltu)  return reg(OP_SLTU, insn.rd(), insn.rs1(), insn.rs2());
+  if (f == fast_rv64i_xor)   return reg(OP_XOR, insn.rd(), insn.rs1(), insn.rs2());
+  if (f == fast_rv64i_srl)   return reg(OP_SRL, insn.rd(), insn.rs1(), insn.rs2());
+  if (f == fast_rv64i_sra)   return reg(OP_SRA, insn.rd(), insn.rs1(), insn.rs2());
+  if (f == fast_rv64i_or)    return reg(OP_OR, insn.rd(), insn.rs1(), insn.rs2());
+  if (f == fast_rv64i_and)   return reg(OP_AND, insn.rd(), insn.rs1(), insn.rs2());
+  if (f == fast_rv64i_addiw) return imm(OP_ADDW, insn.rd(), insn.rs1(), insn.i_imm());
+  if (f == fast_rv64i_slliw) return imm(OP_SLLW, insn.rd(), insn.rs1(), insn.i_imm() & 0x3F);
+  if (f == fast_rv64i_srliw) return imm(OP_SRLW, insn.rd(), insn.rs1(), insn.i_imm() & 0x3F);
+  if (f == fast_rv64i_sraiw) return imm(OP_SRAW, insn.rd(), insn.rs1(), insn.i_imm() & 0x3F);
+  if (f == fast_rv64i_addw)  return reg(OP_ADDW, insn.rd(), insn.rs1(), insn.rs2());
+  if (f == fast_rv64i_subw)  return reg(OP_SUBW, insn.rd(), insn.rs1(), insn.rs2());
+  if (f == fast_rv64i_sllw)  return reg(OP_SLLW, insn.rd(), insn.rs1(), insn.rs2());
+  if (f == fast_rv64i_srlw)  return reg(OP_SRLW, insn.rd(), insn.rs1(), insn.rs2());
+  if (f == fast_rv64i_sraw)  return reg(OP_SRAW, insn.rd(), insn.rs1(), insn.rs2());
+  if (f == fast_rv64i_mul)   return mul && reg(OP_MUL, insn.rd(), insn.rs1(), insn.rs2());
+  if (f == fast_rv64i_mulw)  return mul && reg(OP_MULW, insn.rd(), insn.rs1(), insn.rs2());
+  if (f == fast_rv64i_lb)    return load(insn.rd(), insn.rs1(), insn.i_imm(), 1, true);
+  if (f == fast_rv64i_lh)    return load(insn.rd(), insn.rs1(), insn.i_imm(), 2, true);
+  if (f == fast_rv64i_lw)    return load(insn.rd(), insn.rs1(), insn.i_imm(), 4, true);
+  if (f == fast_rv64i_ld)    return load(insn.rd(), insn.rs1(), insn.i_imm(), 8, true);
+  if (f == fast_rv64i_lbu)   return load(insn.rd(), insn.rs1(), insn.i_imm(), 1, false);
+  if (f == fast_rv64i_lhu)   return load(insn.rd(), insn.rs1(), insn.i_imm(), 2, false);
+  if (f == fast_rv64i_lwu)   return load(insn.rd(), insn.rs1(), insn.i_imm(), 4, false);
+  if (f == fast_rv64i_sb)    return store(insn.rs1(), insn.rs2(), insn.s_imm(), 1);
+  if (f == fast_rv64i_sh)    return store(insn.rs1(), insn.rs2(), insn.s_imm(), 2);
+  if (f == fast_rv64i_sw)    return store(insn.rs1(), insn.rs2(), insn.s_imm(), 4);
+  if (f == fast_rv64i_sd)    return store(insn.rs1(), insn.rs2(), insn.s_imm(), 8);
+
+  if (!rvc)
+    return false;
+
+  // RV64 interpretations of the compressed encodings, and only those that
+  // pass the checks of the corresponding routine in insns/
+  if (f == fast_rv64i_c_addi)
+    return imm(OP_ADD, insn.rvc_rd(), insn.rvc_rs1(), insn.rvc_imm());
+  if (f == fast_rv64i_c_jal) // c.addiw
+    return insn.rvc_rd() != 0 && imm(OP_ADDW, insn.rvc_rd(), insn.rvc_rs1(), insn.rvc_imm());
+  if (f == fast_rv64i_c_li)
+    return imm(OP_ADD, insn.rvc_rd(), 0, insn.rvc_imm());
+  if (f == fast_rv64i_c_lui) {
+    if (insn.rvc_rd() == 2) // c.addi16sp
+      return insn.rvc_addi16sp_imm() != 0 && imm(OP_ADD, 2, 2, insn.rvc_addi16sp_imm());
+    return insn.rvc_imm() != 0 && imm(OP_ADD, insn.rvc_rd(), 0, insn.rvc_imm() << 12);
+  }
+  if (f == fast_rv64i_c_mv)
+    return insn.rvc_rs2() != 0 && reg(OP_ADD, insn.rvc_rd(), 0, insn.rvc_rs2());
+  if (f == fast_rv64i_c_add)
+    return insn.rvc_rs2() != 0 && reg(OP_ADD, insn.rvc_rd(), insn.rvc_rs1(), insn.rvc_rs2());
+  if (f == fast_rv64i_c_sub)
+    return reg(OP_SUB, insn.rvc_rs1s(), insn.rvc_rs1s(), insn.rvc_rs2s());
+  if (f == fast_rv64i_c_xor)
+    return reg(OP_XOR, insn.rvc_rs1s(), insn.rvc_rs1s(), insn.rvc_rs2s());
+  if (f == fast_rv64i_c_or)
+    return reg(OP_OR, insn.rvc_rs1s(), insn.rvc_rs1s(), insn.rvc_rs2s());
+  if (f == fast_rv64i_c_and)
+    return reg(OP_AND, insn.rvc_rs1s(), insn.rvc_rs1s(), insn.rvc_rs2s());
+  if (f == fast_rv64i_c_subw)
+    return reg(OP_SUBW, insn.rvc_rs1s(), insn.rvc_rs1s(), insn.rvc_rs2s());
+  if (f == fast_rv64i_c_addw)
+    return reg(OP_ADDW, insn.rvc_rs1s(), insn.rvc_rs1s(), insn.rvc_rs2s());
+  if (f == fast_rv64i_c_andi)
+    return imm(OP_AND, insn.rvc_rs1s(), insn.rvc_rs1s(), insn.rvc_imm());
+  if (f == fast_rv64i_c_slli)
+    return imm(OP_SLL, insn.rvc_rd(), insn.rvc_rs1(), insn.rvc_zimm());
+  if (f == fast_rv64i_c_srli)
+    return imm(OP_SRL, insn.rvc_rs1s(), insn.rvc_rs1s(), insn.rvc_zimm());
+  if (f == fast_rv64i_c_srai)
+    return imm(OP_SRA, insn.rvc_rs1s(), insn.rvc_rs1s(), insn.rvc_zimm());
+  if (f == fast_rv64i_c_flw) // c.ld
+    return load(insn.rvc_rs2s(), insn.rvc_rs1s(), insn.rvc_ld_imm(), 8, true);
+  if (f == fast_rv64i_c_lw)
+    return load(insn.rvc_rs2s(), insn.rvc_rs1s(), insn.rvc_lw_imm(), 4, true);
+  if (f == fast_rv64i_c_fsw) // c.sd
+    return store(insn.rvc_rs1s(), insn.rvc_rs2s(), insn.rvc_ld_imm(), 8);
+  if (f == fast_rv64i_c_sw)
+    return store(insn.rvc_rs1s(), insn.rvc_rs2s(), insn.rvc_lw_imm(), 4);
+  if (f == fast_rv64i_c_flwsp) // c.ldsp
+    return insn.rvc_rd() != 0 && load(insn.rvc_rd(), 2, insn.rvc_ldsp_imm(), 8, true);
+  if (f == fast_rv64i_c_lwsp)
+    return insn.rvc_rd() != 0 && load(insn.rvc_rd(), 2, insn.rvc_lwsp_imm(), 4, true);
+  if (f == fast_rv64i_c_fswsp) // c.sdsp
+    return store(2, insn.rvc_rs2(), insn.rvc_sdsp_imm(), 8);
+  if (f == fast_rv64i_c_swsp)
+    return store(2, insn.rvc_rs2(), insn.rvc_swsp_imm(), 4);
+  if (f == fast_rv64i_c_addi4spn)
+    return insn.rvc_addi4spn_imm() != 0 && imm(OP_ADD, insn.rvc_rs2s(), 2, insn.rvc_addi4spn_imm());
+
+  return false;
+}
+
+void jit_t::compile(insn_block_t* block, reg_t pc)
+{
+#ifdef JIT_X86_64
+  // The final instruction of a block is always left to the interpreter,
+  // which brings state.pc up to date before executing it.
+  jit_insn_t insns[insn_block_t::MAX_INSNS];
+  size_t n = 0;
+  for (reg_t insn_pc = pc; n + 1 < block->length; n++) {
+    if (!translate(block->insns[n], insn_pc, &insns[n]))
+      break;
+    insn_pc += block->insns[n].insn.length();
+  }
+
+  if (n == 0)
+    return;
+
+  buf.clear();
+  exits.clear();
+
+  for (size_t i = 0; i < n; i++)
+    emit(insns[i], i);
+
+  // mov eax, n; ret
+  emit_bytes({0xB8});
+  emit_imm32(n);
+  emit_bytes({0xC3});
+
+  // early exits report how many instructions completed
+  size_t stub = 0;
+  for (size_t i = 0; i < exits.size(); i++) {
+    size_t fixup = exits[i].first;
+    size_t index = exits[i].second;
+    if (i == 0 || index != exits[i - 1].second) {
+      stub = buf.size();
+      emit_bytes({0xB8});
+      emit_imm32(index);
+      emit_bytes({0xC3});
+    }
+    int32_t rel = stub - (fixup + 4);
+    memcpy(&buf[fixup], &rel, sizeof(rel));
+  }
+
+  if (code_used + buf.size() > CODE_SIZE) {
+    // drop all translations; the current block remains usable until its
+    // next lookup, which refills it
+    mmu->flush_icache();
+    code_used = 0;
+  }
+
+  memcpy(code + code_used, buf.data(), buf.size());
+  block->jit = (jit_func_t)(code + code_used);
+  code_used += buf.size();
+#endif
+}
+
+void jit_t::emit(const jit_insn_t& insn, size_t index)
+{
+  if (insn.op == OP_LOAD || insn.op == OP_STORE) {
+    // rax = effective address
+    emit_load_xpr(RAX, insn.rs1);
+    emit_load_imm(RCX, insn.imm);
+    emit_bytes({0x48, 0x01, 0xC8});             // add rax, rcx
+
+    if (insn.op == OP_LOAD) {
+      emit_tlb_lookup(mmu->tlb_load_tag, insn.size, index);
+      switch (insn.size) {
+        case 1: emit_bytes(insn.sign ? std::initializer_list<uint8_t>{0x48, 0x0F, 0xBE, 0x00}
+                                     : std::initializer_list<uint8_t>{0x0F, 0xB6, 0x00}); break;
+        case 2: emit_bytes(insn.sign ? std::initializer_list<uint8_t>{0x48, 0x0F, 0xBF, 0x00}
+                                     : std::initializer_list<uint8_t>{0x0F, 0xB7, 0x00}); break;
+        case 4: emit_bytes(insn.sign ? std::initializer_list<uint8_t>{0x48, 0x63, 0x00}
+                                     : std::initializer_list<uint8_t>{0x8B, 0x00}); break;
+        case 8: emit_bytes({0x48, 0x8B, 0x00}); break;
+      }
+      if (insn.rd != 0)
+        emit_store_xpr(RAX, insn.rd);
+    } else {
+      emit_tlb_lookup(mmu->tlb_store_tag, insn.size, index);
+      emit_load_xpr(RCX, insn.rs2);
+      switch (insn.size) {
+        case 1: emit_bytes({0x88, 0x08}); break;       // mov [rax], cl
+        case 2: emit_bytes({0x66, 0x89, 0x08}); break; // mov [rax], cx
+        case 4: emit_bytes({0x89, 0x08}); break;       // mov [rax], ecx
+        case 8: emit_bytes({0x48, 0x89, 0x08}); break; // mov [rax], rcx
+      }
+    }
+    return;
+  }
+
+  // ALU operations cannot fail, so writes to x0 are simply dropped
+  if (insn.rd == 0)
+    return;
+
+  emit_load_xpr(RAX, insn.rs1);
+  if (insn.use_imm)
+    emit_load_imm(RCX, insn.imm);
+  else
+    emit_load_xpr(RCX, insn.rs2);
+
+  switch (insn.op) {
+    case OP_ADD:  emit_bytes({0x48, 0x01, 0xC8}); break;             // add rax, rcx
+    case OP_SUB:  emit_bytes({0x48, 0x29, 0xC8}); break;             // sub rax, rcx
+    case OP_AND:  emit_bytes({0x48, 0x21, 0xC8}); break;             // and rax, rcx
+    case OP_OR:   emit_bytes({0x48, 0x09, 0xC8}); break;             // or rax, rcx
+    case OP_XOR:  emit_bytes({0x48, 0x31, 0xC8}); break;             // xor rax, rcx
+    case OP_SLL:  emit_bytes({0x48, 0xD3, 0xE0}); break;             // shl rax, cl
+    case OP_SRL:  emit_bytes({0x48, 0xD3, 0xE8}); break;             // shr rax, cl
+    case OP_SRA:  emit_bytes({0x48, 0xD3, 0xF8}); break;             // sar rax, cl
+    case OP_MUL:  emit_bytes({0x48, 0x0F, 0xAF, 0xC1}); break;       // imul rax, rcx
+    case OP_SLT:
+    case OP_SLTU:
+      emit_bytes({0x48, 0x39, 0xC8});                                // cmp rax, rcx
+      emit_bytes({0x0F, uint8_t(insn.op == OP_SLT ? 0x9C : 0x92), 0xC0}); // setl/setb al
+      emit_bytes({0x0F, 0xB6, 0xC0});                                // movzx eax, al
+      break;
+    case OP_ADDW: emit_bytes({0x01, 0xC8, 0x48, 0x63, 0xC0}); break; // add eax, ecx; movsxd rax, eax
+    case OP_SUBW: emit_bytes({0x29, 0xC8, 0x48, 0x63, 0xC0}); break; // sub eax, ecx; movsxd rax, eax
+    case OP_SLLW: emit_bytes({0xD3, 0xE0, 0x48, 0x63, 0xC0}); break; // shl eax, cl; movsxd rax, eax
+    case OP_SRLW: emit_bytes({0xD3, 0xE8, 0x48, 0x63, 0xC0}); break; // shr eax, cl; movsxd rax, eax
+    case OP_SRAW: emit_bytes({0xD3, 0xF8, 0x48, 0x63, 0xC0}); break; // sar eax, cl; movsxd rax, eax
+    case OP_MULW: emit_bytes({0x0F, 0xAF, 0xC1, 0x48, 0x63, 0xC0}); break; // imul eax, ecx; movsxd rax, eax
+    case OP_LOAD:
+    case OP_STORE:
+      abort();
+  }
+
+  emit_store_xpr(RAX, insn.rd);
+}
+
+// Leave the host address of the access at rax in rax, or exit translated
+// code reporting that instruction index has not been executed.  Mirrors the
+// fast path of mmu_t::load and mmu_t::store.
+void jit_t::emit_tlb_lookup(const reg_t* tags, unsigned size, size_t index)
+{
+  emit_bytes({0x48, 0x89, 0xC2});                 // mov rdx, rax
+  emit_bytes({0x48, 0xC1, 0xEA, PGSHIFT});        // shr rdx, PGSHIFT
+  emit_bytes({0x89, 0xD6});                       // mov esi, edx
+  emit_bytes({0x81, 0xE6});                       // and esi, TLB_ENTRIES - 1
+  emit_imm32(mmu_t::TLB_ENTRIES - 1);
+  emit_load_imm(R8, (int64_t)tags);
+  emit_bytes({0x49, 0x3B, 0x14, 0xF0});           // cmp rdx, [r8 + rsi * 8]
+  emit_bytes({0x0F, 0x85});                       // jne exit
+  exits.push_back(std::make_pair(buf.size(), index));
+  emit_imm32(0);
+
+  if (size > 1) {
+    emit_bytes({0xA8, uint8_t(size - 1)});        // test al, size - 1
+    emit_bytes({0x0F, 0x85});                     // jnz exit
+    exits.push_back(std::make_pair(buf.size(), index));
+    emit_imm32(0);
+  }
+
+  emit_bytes({0x48, 0xC1, 0xE6, 0x04});           // shl rsi, 4
+  emit_load_imm(R8, (int64_t)mmu->tlb_data);
+  emit_bytes({0x49, 0x03, 0x04, 0x30});           // add rax, [r8 + rsi]
+}
+
+void jit_t::emit_bytes(std::initializer_list<uint8_t> bytes)
+{
+  buf.insert(buf.end(), bytes);
+}
+
+void jit_t::emit_imm32(uint32_t imm)
+{
+  for (int i = 0; i < 4; i++)
+    buf.push_back(imm >> (8 * i));
+}
+
+void jit_t::emit_imm64(uint64_t imm)
+{
+  emit_imm32(imm);
+  emit_imm32(imm >> 32);
+}
+
+// mov host_reg, [rdi + 8 * xreg]
+void jit_t::emit_load_xpr(unsigned host_reg, unsigned xreg)
+{
+  emit_bytes({uint8_t(0x48 | (host_reg >> 3) << 2), 0x8B, uint8_t(0x87 | (host_reg & 7) << 3)});
+  emit_imm32(xreg * sizeof(reg_t));
+}
+
+// mov [rdi + 8 * xreg], host_reg
+void jit_t::emit_store_xpr(unsigned host_reg, unsigned xreg)
+{
+  emit_bytes({uint8_t(0x48 | (host_reg >> 3) << 2), 0x89, uint8_t(0x87 | (host_reg & 7) << 3)});
+  emit_imm32(xreg * sizeof(reg_t));
+}
+
+void jit_t::emit_load_imm(unsigned host_reg, int64_t imm)
+{
+  uint8_t rex = 0x48 | (host_reg >> 3);
+  if (imm == (int32_t)imm) {
+    emit_bytes({rex, 0xC7, uint8_t(0xC0 | (host_reg & 7))}); // mov host_reg, simm32
+    emit_imm32(imm);
+  } else {
+    emit_bytes({rex, uint8_t(0xB8 | (host_reg & 7))});       // movabs host_reg, imm64
+    emit_imm64(imm);
+  }
+}
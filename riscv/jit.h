@@ -0,0 +1,72 @@
+// See LICENSE for license details.
+#ifndef _RISCV_JIT_H
+#define _RISCV_JIT_H
+
+#include "decode.h"
+#include "mmu.h"
+#include <vector>
+
+class processor_t;
+
+// An optional translator from hot RV64 blocks to host machine code.  Only
+// the integer register-register, register-immediate, load and store
+// instructions of RV64IMC are translated; a block is translated up to, but
+// not including, its first instruction that is not, and the remainder is
+// left to the interpreter.  Translated code never raises exceptions: loads
+// and stores that miss in the TLB or are misaligned leave translated code
+// early so that the interpreter can take the slow path.
+class jit_t
+{
+public:
+  // number of executions after which a block is translated
+  static const size_t HOT_THRESHOLD = 16;
+
+  jit_t(processor_t* proc);
+  ~jit_t();
+
+  // is translation supported on the host we were compiled for?
+  static bool host_supported();
+
+  // translate the longest supported prefix of the block starting at pc
+  void compile(insn_block_t* block, reg_t pc);
+
+private:
+  enum op_t {
+    OP_ADD, OP_SUB, OP_AND, OP_OR, OP_XOR,
+    OP_SLL, OP_SRL, OP_SRA, OP_SLT, OP_SLTU, OP_MUL,
+    OP_ADDW, OP_SUBW, OP_SLLW, OP_SRLW, OP_SRAW, OP_MULW,
+    OP_LOAD, OP_STORE,
+  };
+
+  struct jit_insn_t {
+    op_t op;
+    unsigned rd, rs1, rs2;
+    bool use_imm;
+    int64_t imm;
+    unsigned size;  // of the memory access, for loads and stores
+    bool sign;      // does a load sign-extend?
+  };
+
+  bool translate(insn_fetch_t fetch, reg_t pc, jit_insn_t* out);
+
+  void emit(const jit_insn_t& insn, size_t index);
+  void emit_bytes(std::initializer_list<uint8_t> bytes);
+  void emit_imm32(uint32_t imm);
+  void emit_imm64(uint64_t imm);
+  void emit_load_xpr(unsigned host_reg, unsigned xreg);
+  void emit_store_xpr(unsigned host_reg, unsigned xreg);
+  void emit_load_imm(unsigned host_reg, int64_t imm);
+  void emit_tlb_lookup(const reg_t* tags, unsigned size, size_t index);
+
+  processor_t* proc;
+  mmu_t* mmu;
+
+  uint8_t* code;
+  size_t code_used;
+
+  // the block being translated, and its early exits to patch
+  std::vector<uint8_t> buf;
+  std::vector<std::pair<size_t, size_t>> exits;
+};
+
+#endif
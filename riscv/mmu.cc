@@ -5,9 +5,12 @@
 #include "arith.h"
 #include "simif.h"
 #include "processor.h"
+#include "fusion.h"
+#include <algorithm>
 
 mmu_t::mmu_t(simif_t* sim, endianness_t endianness, processor_t* proc)
- : sim(sim), proc(proc),
+ : sim(sim), proc(proc), concurrent(false), private_view(false),
+  deferred_access(false),
 #ifdef RISCV_ENABLE_DUAL_ENDIAN
   target_big_endian(endianness == endianness_big),
 #endif
@@ -19,29 +22,320 @@ mmu_t::mmu_t(simif_t* sim, endianness_t endianness, processor_t* proc)
 #ifndef RISCV_ENABLE_DUAL_ENDIAN
   assert(endianness == endianness_little);
 #endif
+  // without a hart there is nothing to translate
+  tlb_l2_sets = proc ? proc->get_cfg().tlb_sets : 0;
+  tlb_l2_ways = proc ? proc->get_cfg().tlb_ways : 0;
+  tlb_l2.resize(tlb_l2_sets * tlb_l2_ways);
+  tlb_l2_victim.resize(tlb_l2_sets);
   flush_tlb();
   yield_load_reservation();
 }
 
 mmu_t::~mmu_t()
 {
+  if (proc && proc->get_cfg().tlb_stats) {
+    fprintf(stderr, "core %3d: TLB L2 hits: %" PRIu64 " misses: %" PRIu64 "\n",
+            (int)proc->get_id(), tlb_l2_hits, tlb_l2_misses);
+    fprintf(stderr, "core %3d: page-walk cache hits: %" PRIu64 " misses: %" PRIu64 "\n",
+            (int)proc->get_id(), pwc_hits, pwc_misses);
+    fprintf(stderr, "core %3d: G-stage TLB hits: %" PRIu64 " misses: %" PRIu64 "\n",
+            (int)proc->get_id(), gstage_hits, gstage_misses);
+  }
+
+  for (auto [shared, copy] : private_pages)
+    free(copy);
+  for (auto page : spare_pages)
+    free(page);
 }
 
 void mmu_t::flush_icache()
 {
-  for (size_t i = 0; i < ICACHE_ENTRIES; i++)
-    icache[i].tag = -1;
+  for (size_t i = 0; i < BLOCK_CACHE_ENTRIES; i++)
+    block_cache[i].tag = -1;
+}
+
+// Instructions that may redirect control flow, serialize the pipeline, or
+// otherwise observe state.pc must end a block.  Be conservative about
+// anything outside the base opcode map.
+static bool insn_ends_block(insn_t insn)
+{
+  insn_bits_t bits = insn.bits();
+
+  switch (insn.length()) {
+    case 2:
+      return (bits & MASK_C_J) == MATCH_C_J ||
+             (bits & MASK_C_JAL) == MATCH_C_JAL ||
+             (bits & MASK_C_JR) == MATCH_C_JR ||
+             (bits & MASK_C_JALR) == MATCH_C_JALR ||
+             (bits & MASK_C_BEQZ) == MATCH_C_BEQZ ||
+             (bits & MASK_C_BNEZ) == MATCH_C_BNEZ ||
+             (bits & MASK_CM_JALT) == MATCH_CM_JALT ||
+             (bits & MASK_CM_POPRET) == MATCH_CM_POPRET ||
+             (bits & MASK_CM_POPRETZ) == MATCH_CM_POPRETZ;
+    case 4:
+      switch (bits & 0x7f) {
+        case 0x0b: // custom-0
+        case 0x0f: // MISC-MEM
+        case 0x2b: // custom-1
+        case 0x5b: // custom-2
+        case 0x63: // BRANCH
+        case 0x67: // JALR
+        case 0x6f: // JAL
+        case 0x73: // SYSTEM
+        case 0x7b: // custom-3
+          return true;
+      }
+      return false;
+    default:
+      return true;
+  }
+}
+
+bool mmu_t::block_extendable(reg_t block_pc, reg_t pc)
+{
+  // With data triggers armed, a trigger that fires after an instruction must
+  // be taken before the next one, so fall back to one instruction per block.
+  if (check_triggers_load || check_triggers_store)
+    return false;
+
+  // Only extend within a page whose fetches are guaranteed to hit in the ITLB,
+  // so that no fault can be raised on behalf of a later instruction before
+  // the earlier ones have executed.
+  reg_t vpn = pc >> PGSHIFT;
+  if (vpn != block_pc >> PGSHIFT || tlb_insn_tag[vpn % TLB_ENTRIES] != vpn)
+    return false;
+
+  auto tlb_entry = tlb_data[vpn % TLB_ENTRIES];
+  int length = insn_length(from_le(*(const uint16_t*)(tlb_entry.host_offset + pc)));
+  if (((pc + length - 1) >> PGSHIFT) != vpn)
+    return false;
+
+  reg_t paddr = tlb_entry.target_offset + pc;
+  return !tracer.interested_in_range(paddr, paddr + 1, FETCH);
+}
+
+insn_block_t* mmu_t::refill_block_cache(reg_t addr, insn_block_t* block)
+{
+  if (matched_trigger)
+    throw *matched_trigger;
+
+  block->tag = -1;
+  block->length = 0;
+  block->executions = 0;
+  block->jit = NULL;
+  block->fusions = 0;
+  std::fill_n(block->fused, insn_block_t::MAX_INSNS, nullptr);
+
+  reg_t pc = addr;
+  while (true) {
+    bool traced;
+    insn_fetch_t fetch = fetch_insn(pc, &traced);
+    block->insns[block->length++] = fetch;
+
+    // traced fetches must be observed every time they execute
+    if (traced)
+      return block;
+
+    // instructions that fail to decode trap without unwinding, which only
+    // the last instruction of a block may do
+    pc += fetch.insn.length();
+    if (block->length == insn_block_t::MAX_INSNS || insn_ends_block(fetch.insn) ||
+        fetch.func == &illegal_instruction || !block_extendable(addr, pc))
+      break;
+  }
+
+  block->tag = addr;
+  if (proc && proc->get_cfg().fuse)
+    fuse_block(proc, block);
+  return block;
 }
 
 void mmu_t::flush_tlb()
+{
+  for (auto& entry : tlb_l2)
+    entry.access = 0;
+  for (auto& entry : pwc)
+    entry.valid = false;
+  for (auto& entry : gstage_tlb)
+    entry.access = 0;
+
+  switch_tlb_context();
+}
+
+void mmu_t::switch_tlb_context()
 {
   memset(tlb_insn_tag, -1, sizeof(tlb_insn_tag));
   memset(tlb_load_tag, -1, sizeof(tlb_load_tag));
   memset(tlb_store_tag, -1, sizeof(tlb_store_tag));
+  memset(tlb_mmio_load_tag, -1, sizeof(tlb_mmio_load_tag));
+  memset(tlb_mmio_store_tag, -1, sizeof(tlb_mmio_store_tag));
 
   flush_icache();
 }
 
+void mmu_t::flush_tlb_vma(bool virt, std::optional<reg_t> vaddr, std::optional<reg_t> asid)
+{
+  bool rv32 = proc->get_const_xlen() == 32;
+  reg_t asid_mask = rv32 ? SATP32_ASID : SATP64_ASID;
+  reg_t vmid_mask = rv32 ? HGATP32_VMID : HGATP64_VMID;
+  reg_t vpn_mask = rv32 ? (reg_t(1) << (32 - PGSHIFT)) - 1 : reg_t(-1);
+  reg_t vmid = virt ? proc->get_state()->hgatp->read() & vmid_mask : 0;
+
+  auto fenced = [&](const auto& entry) {
+    if (entry.virt != virt || (virt && (entry.hgatp & vmid_mask) != vmid))
+      return false;
+    // a superpage is dropped by a fence for any address within it
+    if (vaddr && (((entry.vpn ^ (*vaddr >> PGSHIFT)) & vpn_mask) >> entry.span) != 0)
+      return false;
+    return !asid || (!entry.global && (entry.satp & asid_mask) == set_field(reg_t(0), asid_mask, *asid));
+  };
+
+  for (auto& entry : tlb_l2) {
+    if (fenced(entry))
+      entry.access = 0;
+  }
+
+  // A fence for one address need only order its leaf PTE, but software that
+  // frees a page table often fences just the addresses it mapped, so drop
+  // the tables on the way to the address too.
+  for (auto& entry : pwc) {
+    if (entry.valid && fenced(entry))
+      entry.valid = false;
+  }
+
+  switch_tlb_context();
+}
+
+void mmu_t::flush_tlb_gvma(std::optional<reg_t> gaddr, std::optional<reg_t> vmid)
+{
+  reg_t vmid_mask = proc->get_const_xlen() == 32 ? HGATP32_VMID : HGATP64_VMID;
+  auto fenced = [&](reg_t hgatp) {
+    return !vmid || (hgatp & vmid_mask) == set_field(reg_t(0), vmid_mask, *vmid);
+  };
+
+  for (auto& entry : gstage_tlb) {
+    if (fenced(entry.hgatp) && (!gaddr || ((entry.gpn ^ (*gaddr >> PGSHIFT)) >> entry.span) == 0))
+      entry.access = 0;
+  }
+
+  // Any of the guest's page walks may have read its page tables through the
+  // mapping of gaddr, so its combined translations all go.
+  for (auto& entry : tlb_l2) {
+    if (entry.virt && fenced(entry.hgatp))
+      entry.access = 0;
+  }
+  for (auto& entry : pwc) {
+    if (entry.virt && fenced(entry.hgatp))
+      entry.valid = false;
+  }
+
+  switch_tlb_context();
+}
+
+std::optional<reg_t> mmu_t::tlb_l2_lookup(const tlb_l2_entry_t& tag, access_type type)
+{
+  tlb_l2_entry_t* set = tlb_l2_set(tag);
+  for (size_t way = 0; way < tlb_l2_ways; way++) {
+    if ((set[way].access & (1 << type)) && set[way].same_tag(tag))
+      return set[way].ppage;
+  }
+  return std::nullopt;
+}
+
+void mmu_t::tlb_l2_insert(tlb_l2_entry_t entry, access_type type)
+{
+  tlb_l2_entry_t* set = tlb_l2_set(entry);
+  size_t way = 0;
+  while (way < tlb_l2_ways && !(set[way].access && set[way].same_tag(entry)))
+    way++;
+
+  if (way < tlb_l2_ways) {
+    // another access type's walk found the same page
+    if (set[way].ppage == entry.ppage)
+      entry.access |= set[way].access;
+  } else {
+    way = 0;
+    while (way < tlb_l2_ways && set[way].access)
+      way++;
+    if (way == tlb_l2_ways) {
+      size_t& victim = tlb_l2_victim[(set - tlb_l2.data()) / tlb_l2_ways];
+      way = victim;
+      victim = (victim + 1) % tlb_l2_ways;
+    }
+  }
+
+  entry.access |= 1 << type;
+  set[way] = entry;
+}
+
+void mmu_t::flush_tlb_host_pages(const std::function<bool(const char*)>& match)
+{
+  for (size_t idx = 0; idx < TLB_ENTRIES; idx++) {
+    // all valid tags of an entry hold the same vpn
+    reg_t tag = tlb_insn_tag[idx] & tlb_load_tag[idx] & tlb_store_tag[idx];
+    if (tag == (reg_t)-1)
+      continue;
+    reg_t vpn = tag & ~TLB_CHECK_TRIGGERS;
+    if (match(tlb_data[idx].host_offset + (vpn << PGSHIFT))) {
+      tlb_insn_tag[idx] = -1;
+      tlb_load_tag[idx] = -1;
+      tlb_store_tag[idx] = -1;
+    }
+  }
+}
+
+void mmu_t::set_private(bool value)
+{
+  if (value) {
+    // the first store to each page must go through host_addr
+    memset(tlb_store_tag, -1, sizeof(tlb_store_tag));
+  } else {
+    flush_tlb_host_pages([this](const char* page) {
+      return std::any_of(private_pages.begin(), private_pages.end(),
+                         [page](auto& p) { return p.second == page; });
+    });
+    for (auto [shared, copy] : private_pages)
+      spare_pages.push_back(copy);
+    private_pages.clear();
+  }
+  private_view = value;
+}
+
+void mmu_t::defer_access()
+{
+  deferred_access = true;
+  throw defer_access_t();
+}
+
+char* mmu_t::host_addr(reg_t paddr, access_type type)
+{
+  char* host_addr = sim->addr_to_mem(paddr);
+  if (likely(!private_view) || !host_addr)
+    return host_addr;
+
+  reg_t offset = paddr % PGSIZE;
+  char* shared = host_addr - offset;
+  auto it = private_pages.find(shared);
+  if (it != private_pages.end())
+    return it->second + offset;
+  if (type != STORE)
+    return host_addr;
+
+  char* copy;
+  if (spare_pages.empty()) {
+    copy = (char*)malloc(PGSIZE);
+  } else {
+    copy = spare_pages.back();
+    spare_pages.pop_back();
+  }
+  memcpy(copy, shared, PGSIZE);
+  private_pages[shared] = copy;
+
+  // loads and fetches from this page must see the copy from now on
+  flush_tlb_host_pages([shared](const char* page) { return page == shared; });
+  return copy + offset;
+}
+
 void throw_access_exception(bool virt, reg_t addr, access_type type)
 {
   switch (type) {
@@ -77,7 +371,7 @@ tlb_entry_t mmu_t::fetch_slow_path(reg_t vaddr)
   reg_t vpn = vaddr >> PGSHIFT;
   if (unlikely(tlb_insn_tag[vpn % TLB_ENTRIES] != (vpn | TLB_CHECK_TRIGGERS))) {
     reg_t paddr = translate(access_info, sizeof(fetch_temp));
-    if (auto host_addr = sim->addr_to_mem(paddr)) {
+    if (auto host_addr = this->host_addr(paddr, FETCH)) {
       result = refill_tlb(vaddr, paddr, host_addr, FETCH);
     } else {
       if (!mmio_fetch(paddr, sizeof fetch_temp, (uint8_t*)&fetch_temp))
@@ -148,6 +442,9 @@ bool mmu_t::mmio_store(reg_t paddr, size_t len, const uint8_t* bytes)
 
 bool mmu_t::mmio(reg_t paddr, size_t len, uint8_t* bytes, access_type type)
 {
+  if (unlikely(private_view))
+    defer_access();
+
   bool power_of_2 = (len & (len - 1)) == 0;
   bool naturally_aligned = (paddr & (len - 1)) == 0;
 
@@ -199,13 +496,22 @@ void mmu_t::load_slow_path_intrapage(reg_t len, uint8_t* bytes, mem_access_info_
     return;
   }
 
+  if (!access_info.flags.is_special_access() && vpn == tlb_mmio_load_tag[vpn % TLB_ENTRIES] && mmio_tlb_ok(addr, len)) {
+    if (unlikely(private_view))
+      defer_access();
+    auto entry = tlb_mmio_data[vpn % TLB_ENTRIES];
+    if (!sim->mmio_device_load(entry.dev, entry.offset + addr, len, bytes))
+      throw trap_load_access_fault(access_info.effective_virt, addr, 0, 0);
+    return;
+  }
+
   reg_t paddr = translate(access_info, len);
 
   if (access_info.flags.lr && !sim->reservable(paddr)) {
     throw trap_load_access_fault(access_info.effective_virt, addr, 0, 0);
   }
 
-  if (auto host_addr = sim->addr_to_mem(paddr)) {
+  if (auto host_addr = this->host_addr(paddr, LOAD)) {
     memcpy(bytes, host_addr, len);
     if (tracer.interested_in_range(paddr, paddr + PGSIZE, LOAD))
       tracer.trace(paddr, len, LOAD);
@@ -214,6 +520,8 @@ void mmu_t::load_slow_path_intrapage(reg_t len, uint8_t* bytes, mem_access_info_
 
   } else if (!mmio_load(paddr, len, bytes)) {
     throw trap_load_access_fault(access_info.effective_virt, addr, 0, 0);
+  } else if (!access_info.flags.is_special_access() && mmio_tlb_ok(addr, len)) {
+    refill_tlb_mmio(addr, paddr, LOAD);
   }
 
   if (access_info.flags.lr) {
@@ -262,10 +570,20 @@ void mmu_t::store_slow_path_intrapage(reg_t len, const uint8_t* bytes, mem_acces
     return;
   }
 
+  if (!access_info.flags.is_special_access() && vpn == tlb_mmio_store_tag[vpn % TLB_ENTRIES] &&
+      actually_store && mmio_tlb_ok(addr, len)) {
+    if (unlikely(private_view))
+      defer_access();
+    auto entry = tlb_mmio_data[vpn % TLB_ENTRIES];
+    if (!sim->mmio_device_store(entry.dev, entry.offset + addr, len, bytes))
+      throw trap_store_access_fault(access_info.effective_virt, addr, 0, 0);
+    return;
+  }
+
   reg_t paddr = translate(access_info, len);
 
   if (actually_store) {
-    if (auto host_addr = sim->addr_to_mem(paddr)) {
+    if (auto host_addr = this->host_addr(paddr, STORE)) {
       memcpy(host_addr, bytes, len);
       if (tracer.interested_in_range(paddr, paddr + PGSIZE, STORE))
         tracer.trace(paddr, len, STORE);
@@ -273,7 +591,14 @@ void mmu_t::store_slow_path_intrapage(reg_t len, const uint8_t* bytes, mem_acces
         refill_tlb(addr, paddr, host_addr, STORE);
     } else if (!mmio_store(paddr, len, bytes)) {
       throw trap_store_access_fault(access_info.effective_virt, addr, 0, 0);
+    } else if (!access_info.flags.is_special_access() && mmio_tlb_ok(addr, len)) {
+      refill_tlb_mmio(addr, paddr, STORE);
     }
+  } else if (unlikely(concurrent) && !access_info.flags.is_special_access()) {
+    // let host_atomic perform the access that follows
+    auto host_addr = this->host_addr(paddr, STORE);
+    if (host_addr && !tracer.interested_in_range(paddr, paddr + PGSIZE, STORE))
+      refill_tlb(addr, paddr, host_addr, STORE);
   }
 }
 
@@ -340,6 +665,33 @@ tlb_entry_t mmu_t::refill_tlb(reg_t vaddr, reg_t paddr, char* host_addr, access_
   return entry;
 }
 
+void mmu_t::refill_tlb_mmio(reg_t vaddr, reg_t paddr, access_type type)
+{
+  reg_t idx = (vaddr >> PGSHIFT) % TLB_ENTRIES;
+  reg_t expected_tag = vaddr >> PGSHIFT;
+  reg_t page = paddr & ~reg_t(PGSIZE - 1);
+
+  // whether the debug region may be accessed depends on more than the page
+  if (in_mprv() || !pmp_homogeneous(page, PGSIZE) ||
+      (page <= DEBUG_END && page + PGSIZE > DEBUG_START))
+    return;
+
+  reg_t offset;
+  abstract_device_t* dev = sim->mmio_device(page, PGSIZE, &offset);
+  if (!dev)
+    return;
+
+  if (tlb_mmio_load_tag[idx] != expected_tag)
+    tlb_mmio_load_tag[idx] = -1;
+  if (tlb_mmio_store_tag[idx] != expected_tag)
+    tlb_mmio_store_tag[idx] = -1;
+
+  if (type == STORE) tlb_mmio_store_tag[idx] = expected_tag;
+  else tlb_mmio_load_tag[idx] = expected_tag;
+
+  tlb_mmio_data[idx] = {dev, offset - (expected_tag << PGSHIFT)};
+}
+
 bool mmu_t::pmp_ok(reg_t addr, reg_t len, access_type type, reg_t mode)
 {
   if (!proc || proc->n_pmp == 0)
@@ -392,7 +744,8 @@ reg_t mmu_t::s2xlate(reg_t gva, reg_t gpa, access_type type, access_type trap_ty
   if (!virt)
     return gpa;
 
-  vm_info vm = decode_vm_info(proc->get_const_xlen(), true, 0, proc->get_state()->hgatp->read());
+  reg_t hgatp = proc->get_state()->hgatp->read();
+  vm_info vm = decode_vm_info(proc->get_const_xlen(), true, 0, hgatp);
   if (vm.levels == 0)
     return gpa;
 
@@ -401,6 +754,19 @@ reg_t mmu_t::s2xlate(reg_t gva, reg_t gpa, access_type type, access_type trap_ty
 
   bool mxr = proc->state.sstatus->readvirt(false) & MSTATUS_MXR;
 
+  // HLVX checks execute rather than read permission, so isn't cached
+  reg_t gpn = gpa >> PGSHIFT;
+  reg_t page_mask = (reg_t(1) << PGSHIFT) - 1;
+  gstage_entry_t* cached = &gstage_tlb[(gpn ^ (gpn >> 8) ^ (gpn >> 16) ^ hgatp) % GSTAGE_ENTRIES];
+  bool cached_tag = cached->gpn == gpn && cached->hgatp == hgatp && cached->mxr == mxr;
+  if (!hlvx && (gpa & ~maxgpa) == 0) {
+    if (cached_tag && (cached->access & (1 << type))) {
+      gstage_hits++;
+      return cached->ppage | (gpa & page_mask);
+    }
+    gstage_misses++;
+  }
+
   reg_t base = vm.ptbase;
   if ((gpa & ~maxgpa) == 0) {
     for (int i = vm.levels - 1; i >= 0; i--) {
@@ -450,16 +816,20 @@ reg_t mmu_t::s2xlate(reg_t gva, reg_t gpa, access_type type, access_type trap_ty
           }
         }
 
-        reg_t vpn = gpa >> PGSHIFT;
-        reg_t page_mask = (reg_t(1) << PGSHIFT) - 1;
-
         int napot_bits = ((pte & PTE_N) ? (ctz(ppn) + 1) : 0);
         if (((pte & PTE_N) && (ppn == 0 || i != 0)) || (napot_bits != 0 && napot_bits != 4))
           break;
 
         reg_t page_base = ((ppn & ~((reg_t(1) << napot_bits) - 1))
-                          | (vpn & ((reg_t(1) << napot_bits) - 1))
-                          | (vpn & ((reg_t(1) << ptshift) - 1))) << PGSHIFT;
+                          | (gpn & ((reg_t(1) << napot_bits) - 1))
+                          | (gpn & ((reg_t(1) << ptshift) - 1))) << PGSHIFT;
+
+        if (!hlvx) {
+          // another access type's walk may have found the same page
+          uint8_t access = cached_tag && cached->ppage == page_base ? cached->access : 0;
+          *cached = {gpn, hgatp, mxr, uint8_t(access | (1 << type)),
+                     uint8_t(ptshift + napot_bits), page_base};
+        }
         return page_base | (gpa & page_mask);
       }
     }
@@ -497,8 +867,39 @@ reg_t mmu_t::walk(mem_access_info_t access_info)
   if (masked_msbs != 0 && masked_msbs != mask)
     vm.levels = 0;
 
+  // HLVX checks execute rather than read permission, so isn't cached
+  reg_t vpn = addr >> PGSHIFT;
+  reg_t hgatp = virt ? proc->get_state()->hgatp->read() : 0;
+  tlb_l2_entry_t tlb_l2_tag = {vpn, satp, hgatp, virt, uint8_t(mode), sum, mxr};
+  if (vm.levels != 0 && !hlvx) {
+    if (auto ppage = tlb_l2_lookup(tlb_l2_tag, type)) {
+      tlb_l2_hits++;
+      return *ppage;
+    }
+    tlb_l2_misses++;
+  }
+
+  // start from the deepest table the page-walk cache knows the way to
+  bool global = false;
   reg_t base = vm.ptbase;
-  for (int i = vm.levels - 1; i >= 0; i--) {
+  int start = vm.levels - 1;
+  for (int i = 0; i < start; i++) {
+    unsigned span = (i + 1) * vm.idxbits;
+    pwc_entry_t* entry = pwc_slot(vpn, i, satp, hgatp, span);
+    if (entry->valid && entry->level == i && entry->covers(vpn) && entry->satp == satp &&
+        entry->hgatp == hgatp && entry->virt == virt) {
+      global = entry->global;
+      base = entry->base;
+      start = i;
+      break;
+    }
+  }
+  if (start != vm.levels - 1)
+    pwc_hits++;
+  else if (start > 0)
+    pwc_misses++;
+
+  for (int i = start; i >= 0; i--) {
     int ptshift = i * vm.idxbits;
     reg_t idx = (addr >> (PGSHIFT + ptshift)) & ((1 << vm.idxbits) - 1);
 
@@ -506,6 +907,7 @@ reg_t mmu_t::walk(mem_access_info_t access_info)
     auto pte_paddr = s2xlate(addr, base + idx * vm.ptesize, LOAD, type, virt, false);
     reg_t pte = pte_load(pte_paddr, addr, virt, type, vm.ptesize);
     reg_t ppn = (pte & ~reg_t(PTE_ATTR)) >> PTE_PPN_SHIFT;
+    global |= (pte & PTE_G) != 0;
     bool pbmte = virt ? (proc->get_state()->henvcfg->read() & HENVCFG_PBMTE) : (proc->get_state()->menvcfg->read() & MENVCFG_PBMTE);
     bool hade = virt ? (proc->get_state()->henvcfg->read() & HENVCFG_ADUE) : (proc->get_state()->menvcfg->read() & MENVCFG_ADUE);
 
@@ -521,6 +923,11 @@ reg_t mmu_t::walk(mem_access_info_t access_info)
       if (pte & (PTE_D | PTE_A | PTE_U | PTE_N | PTE_PBMT))
         break;
       base = ppn << PGSHIFT;
+      if (i > 0) {
+        unsigned span = i * vm.idxbits;
+        *pwc_slot(vpn, i - 1, satp, hgatp, span) =
+          {vpn, satp, hgatp, virt, true, global, uint8_t(i - 1), uint8_t(span), base};
+      }
     } else if ((pte & PTE_U) ? s_mode && (type == FETCH || !sum) : !s_mode) {
       break;
     } else if (!(pte & PTE_V) || (!(pte & PTE_R) && (pte & PTE_W))) {
@@ -545,8 +952,6 @@ reg_t mmu_t::walk(mem_access_info_t access_info)
       }
 
       // for superpage or Svnapot NAPOT mappings, make a fake leaf PTE for the TLB's benefit.
-      reg_t vpn = addr >> PGSHIFT;
-
       int napot_bits = ((pte & PTE_N) ? (ctz(ppn) + 1) : 0);
       if (((pte & PTE_N) && (ppn == 0 || i != 0)) || (napot_bits != 0 && napot_bits != 4))
         break;
@@ -555,7 +960,16 @@ reg_t mmu_t::walk(mem_access_info_t access_info)
                         | (vpn & ((reg_t(1) << napot_bits) - 1))
                         | (vpn & ((reg_t(1) << ptshift) - 1))) << PGSHIFT;
       reg_t phys = page_base | (addr & page_mask);
-      return s2xlate(addr, phys, type, type, virt, hlvx) & ~page_mask;
+      reg_t ppage = s2xlate(addr, phys, type, type, virt, hlvx) & ~page_mask;
+
+      if (!hlvx) {
+        tlb_l2_entry_t entry = tlb_l2_tag;
+        entry.span = ptshift + napot_bits;
+        entry.global = global;
+        entry.ppage = ppage;
+        tlb_l2_insert(entry, type);
+      }
+      return ppage;
     }
   }
 
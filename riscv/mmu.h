@@ -14,6 +14,8 @@
 #include "cfg.h"
 #include <stdlib.h>
 #include <vector>
+#include <map>
+#include <functional>
 
 // virtual memory configuration
 #define PGSHIFT 12
@@ -27,10 +29,28 @@ struct insn_fetch_t
   insn_t insn;
 };
 
-struct icache_entry_t {
+// host code for a prefix of a block; returns the number of instructions
+// it executed (see jit.h)
+typedef size_t (*jit_func_t)(reg_t* xpr);
+
+// executes a pair of adjacent instructions as one (see fusion.h)
+typedef reg_t (*fused_func_t)(processor_t* p, const insn_fetch_t* insns, reg_t pc);
+
+// a straight-line run of pre-decoded instructions.  Only the last
+// instruction of a block may redirect control flow or serialize the pipeline.
+struct insn_block_t {
+  static const size_t MAX_INSNS = 8;
+
   reg_t tag;
-  struct icache_entry_t* next;
-  insn_fetch_t data;
+  size_t length;
+  insn_fetch_t insns[MAX_INSNS];
+
+  size_t executions;
+  jit_func_t jit;
+
+  // fused[i], if set, executes insns[i] and insns[i + 1] together
+  size_t fusions;
+  fused_func_t fused[MAX_INSNS];
 };
 
 struct tlb_entry_t {
@@ -38,6 +58,71 @@ struct tlb_entry_t {
   reg_t target_offset;
 };
 
+// An entry of the set-associative second-level TLB, which, unlike the
+// direct-mapped first level, is tagged with everything the translation
+// depends on, and so survives switches of address space and privilege.
+struct tlb_l2_entry_t {
+  // tag
+  reg_t vpn;
+  reg_t satp;     // satp, or vsatp for guests: holds the ASID
+  reg_t hgatp;    // for guests only: holds the VMID
+  bool virt;
+  uint8_t priv;
+  bool sum;
+  bool mxr;
+
+  // data
+  uint8_t access; // a bit per access_type whose checks have passed; 0 if invalid
+  uint8_t span;   // log2 of the number of pages the leaf PTE maps
+  bool global;
+  reg_t ppage;    // physical address of the page
+
+  bool same_tag(const tlb_l2_entry_t& other) const {
+    return vpn == other.vpn && satp == other.satp && hgatp == other.hgatp &&
+           virt == other.virt && priv == other.priv && sum == other.sum &&
+           mxr == other.mxr;
+  }
+};
+
+// An entry of the G-stage TLB, which holds the guest-physical to
+// host-physical translations s2xlate() makes for a guest's accesses and for
+// its page walks.
+struct gstage_entry_t {
+  // tag
+  reg_t gpn;
+  reg_t hgatp;    // holds the VMID
+  bool mxr;
+
+  // data
+  uint8_t access; // a bit per access_type whose checks have passed; 0 if invalid
+  uint8_t span;   // log2 of the number of pages the leaf PTE maps
+  reg_t ppage;    // host physical address of the page
+};
+
+// An entry of the page-walk cache: the page table that a walk for vpn
+// reads at level, reached through non-leaf PTEs whose tags it carries.
+struct pwc_entry_t {
+  reg_t vpn;
+  reg_t satp;
+  reg_t hgatp;
+  bool virt;
+  bool valid;
+  bool global;    // a non-leaf PTE on the way set G
+  uint8_t level;
+  uint8_t span;   // low bits of vpn that don't select the table
+  reg_t base;     // guest physical address of the table
+
+  bool covers(reg_t other_vpn) const {
+    return ((vpn ^ other_vpn) >> span) == 0;
+  }
+};
+
+// A page of a device, reached without translating or searching the bus
+struct tlb_mmio_entry_t {
+  abstract_device_t* dev;
+  reg_t offset;   // the device's offset for a virtual address, less the address
+};
+
 struct xlate_flags_t {
   const bool forced_virt : 1;
   const bool hlvx : 1;
@@ -62,6 +147,10 @@ struct mem_access_info_t {
 
 void throw_access_exception(bool virt, reg_t addr, access_type type);
 
+// thrown instead of making an access that a hart running privately can't
+// (see mmu_t::set_private), so that the instruction is rerun once it's alone
+class defer_access_t {};
+
 // this class implements a processor's port into the virtual memory system.
 // an MMU and instruction cache are maintained for simulator performance.
 class mmu_t
@@ -102,6 +191,8 @@ public:
 
     if (likely(!xlate_flags.is_special_access() && aligned && tlb_hit)) {
       res = *(target_endian<T>*)(tlb_data[vpn % TLB_ENTRIES].host_offset + addr);
+    } else if (!xlate_flags.is_special_access() && tlb_hit && misaligned_fast_ok(addr, sizeof(T))) {
+      memcpy(&res, tlb_data[vpn % TLB_ENTRIES].host_offset + addr, sizeof(T));
     } else {
       load_slow_path(addr, sizeof(T), (uint8_t*)&res, xlate_flags);
     }
@@ -112,12 +203,39 @@ public:
     return from_target(res);
   }
 
+  // a load that hits in the TLB; returns false, having done nothing, if
+  // the load would need the slow path, which might trap
+  template<typename T>
+  bool ALWAYS_INLINE load_fast(reg_t addr, T* res) {
+    reg_t vpn = addr >> PGSHIFT;
+    bool aligned = (addr & (sizeof(T) - 1)) == 0;
+    if (unlikely(!aligned || tlb_load_tag[vpn % TLB_ENTRIES] != vpn))
+      return false;
+
+    *res = from_target(*(target_endian<T>*)(tlb_data[vpn % TLB_ENTRIES].host_offset + addr));
+    return true;
+  }
+
+  // for bulk accesses, such as unit-stride vector loads and stores: a host
+  // pointer to the memory at addr, through which elements of the given size
+  // can be copied directly, or NULL if they need the slow path.  The caller
+  // mustn't copy past the end of addr's page.
+  char* ALWAYS_INLINE load_host_ptr(reg_t addr, reg_t elt_size) {
+    return bulk_host_ptr(addr, elt_size, tlb_load_tag);
+  }
+
+  char* ALWAYS_INLINE store_host_ptr(reg_t addr, reg_t elt_size) {
+    return bulk_host_ptr(addr, elt_size, tlb_store_tag);
+  }
+
   template<typename T>
   T load_reserved(reg_t addr) {
     bool forced_virt = false;
     bool hlvx = false;
     bool lr = true;
-    return load<T>(addr, {forced_virt, hlvx, lr});
+    T res = load<T>(addr, {forced_virt, hlvx, lr});
+    load_reservation_value = res;
+    return res;
   }
 
   template<typename T>
@@ -144,6 +262,9 @@ public:
 
     if (!xlate_flags.is_special_access() && likely(aligned && tlb_hit)) {
       *(target_endian<T>*)(tlb_data[vpn % TLB_ENTRIES].host_offset + addr) = to_target(val);
+    } else if (!xlate_flags.is_special_access() && tlb_hit && misaligned_fast_ok(addr, sizeof(T))) {
+      target_endian<T> target_val = to_target(val);
+      memcpy(tlb_data[vpn % TLB_ENTRIES].host_offset + addr, &target_val, sizeof(T));
     } else {
       target_endian<T> target_val = to_target(val);
       store_slow_path(addr, sizeof(T), (const uint8_t*)&target_val, xlate_flags, true, false);
@@ -176,12 +297,43 @@ public:
       throw trap_store_guest_page_fault(t.get_tval(), t.get_tval2(), t.get_tinst()); \
     }
 
+  // When harts run on several host threads, performs the read-modify-write
+  // of an AMO to memory cached in the TLB with a host atomic, so that it is
+  // atomic with respect to other harts.  Returns false, having done
+  // nothing, if the access must instead go through the usual path.
+  template<typename T, typename op>
+  bool ALWAYS_INLINE host_atomic(reg_t addr, op f, T* lhs) {
+    reg_t vpn = addr >> PGSHIFT;
+    if (likely(!concurrent) || tlb_store_tag[vpn % TLB_ENTRIES] != vpn ||
+        (proc && proc->get_log_commits_enabled()))
+      return false;
+
+    if constexpr (sizeof(T) > sizeof(uint64_t)) {
+      return false;  // e.g. amocas.q, which hosts can't do lock-free
+    } else {
+      auto host_addr = (target_endian<T>*)(tlb_data[vpn % TLB_ENTRIES].host_offset + addr);
+      target_endian<T> old_val, new_val;
+      __atomic_load(host_addr, &old_val, __ATOMIC_RELAXED);
+      do {
+        *lhs = from_target(old_val);
+        new_val = to_target(T(f(*lhs)));
+      } while (!__atomic_compare_exchange(host_addr, &old_val, &new_val, true,
+                                          __ATOMIC_SEQ_CST, __ATOMIC_RELAXED));
+      return true;
+    }
+  }
+
   // template for functions that perform an atomic memory operation
   template<typename T, typename op>
   T amo(reg_t addr, op f) {
+    if (unlikely(private_view))
+      defer_access();
     convert_load_traps_to_store_traps({
       store_slow_path(addr, sizeof(T), nullptr, {false, false, false}, false, true);
-      auto lhs = load<T>(addr);
+      T lhs;
+      if (host_atomic<T>(addr, f, &lhs))
+        return lhs;
+      lhs = load<T>(addr);
       store<T>(addr, f(lhs));
       return lhs;
     })
@@ -189,9 +341,14 @@ public:
 
   template<typename T>
   T amo_compare_and_swap(reg_t addr, T comp, T swap) {
+    if (unlikely(private_view))
+      defer_access();
     convert_load_traps_to_store_traps({
       store_slow_path(addr, sizeof(T), nullptr, {false, false, false}, false, true);
-      auto lhs = load<T>(addr);
+      T lhs;
+      if (host_atomic<T>(addr, [&](T lhs) { return lhs == comp ? swap : lhs; }, &lhs))
+        return lhs;
+      lhs = load<T>(addr);
       if (lhs == comp)
         store<T>(addr, swap);
       return lhs;
@@ -262,21 +419,36 @@ public:
   template<typename T>
   bool store_conditional(reg_t addr, T val)
   {
+    if (unlikely(private_view))
+      defer_access();
+
     bool have_reservation = check_load_reservation(addr, sizeof(T));
 
-    if (have_reservation)
-      store(addr, val);
+    // Other threads' harts don't clear our reservation when they store to
+    // the reserved address, so succeed only if the reserved value is still
+    // in memory.
+    if (have_reservation) {
+      if (unlikely(concurrent))
+        store_slow_path(addr, sizeof(T), nullptr, {false, false, false}, false, true);
+      T lhs;
+      if (host_atomic<T>(addr, [&](T lhs) { return lhs == T(load_reservation_value) ? val : lhs; }, &lhs))
+        have_reservation = lhs == T(load_reservation_value);
+      else if (unlikely(concurrent) && load<T>(addr) != T(load_reservation_value))
+        have_reservation = false;
+      else
+        store(addr, val);
+    }
 
     yield_load_reservation();
 
     return have_reservation;
   }
 
-  static const reg_t ICACHE_ENTRIES = 1024;
+  static const reg_t BLOCK_CACHE_ENTRIES = 1024;
 
-  inline size_t icache_index(reg_t addr)
+  inline size_t block_cache_index(reg_t addr)
   {
-    return (addr / PC_ALIGN) % ICACHE_ENTRIES;
+    return (addr / PC_ALIGN) % BLOCK_CACHE_ENTRIES;
   }
 
   template<typename T>
@@ -285,11 +457,10 @@ public:
     return from_target(*(target_endian<T>*)(tlb_entry.host_offset + addr));
   }
 
-  inline icache_entry_t* refill_icache(reg_t addr, icache_entry_t* entry)
+  // fetch and decode a single instruction.  *traced is set if a memory
+  // tracer observed the fetch, in which case the result must not be cached.
+  inline insn_fetch_t fetch_insn(reg_t addr, bool* traced)
   {
-    if (matched_trigger)
-      throw *matched_trigger;
-
     auto tlb_entry = translate_insn_addr(addr);
     insn_bits_t insn = from_le(*(uint16_t*)(tlb_entry.host_offset + addr));
     int length = insn_length(insn);
@@ -309,35 +480,48 @@ public:
     }
 
     insn_fetch_t fetch = {proc->decode_insn(insn), insn};
-    entry->tag = addr;
-    entry->next = &icache[icache_index(addr + length)];
-    entry->data = fetch;
 
-    reg_t paddr = tlb_entry.target_offset + addr;;
-    if (tracer.interested_in_range(paddr, paddr + 1, FETCH)) {
-      entry->tag = -1;
+    reg_t paddr = tlb_entry.target_offset + addr;
+    *traced = tracer.interested_in_range(paddr, paddr + 1, FETCH);
+    if (*traced)
       tracer.trace(paddr, length, FETCH);
-    }
-    return entry;
+    return fetch;
   }
 
-  inline icache_entry_t* access_icache(reg_t addr)
+  insn_block_t* refill_block_cache(reg_t addr, insn_block_t* block);
+
+  inline insn_block_t* access_block_cache(reg_t addr)
   {
-    icache_entry_t* entry = &icache[icache_index(addr)];
-    if (likely(entry->tag == addr))
-      return entry;
-    return refill_icache(addr, entry);
+    insn_block_t* block = &block_cache[block_cache_index(addr)];
+    if (likely(block->tag == addr))
+      return block;
+    return refill_block_cache(addr, block);
   }
 
   inline insn_fetch_t load_insn(reg_t addr)
   {
-    icache_entry_t entry;
-    return refill_icache(addr, &entry)->data;
+    if (matched_trigger)
+      throw *matched_trigger;
+
+    bool traced;
+    return fetch_insn(addr, &traced);
   }
 
   void flush_tlb();
   void flush_icache();
 
+  // satp, hgatp, the privilege mode or mstatus.SUM/MXR changed: drop the
+  // translations that aren't tagged with them
+  void switch_tlb_context();
+
+  // sfence.vma and hfence.vvma: drop host (virt false) or current guest
+  // translations, of all addresses and address spaces unless given
+  void flush_tlb_vma(bool virt, std::optional<reg_t> vaddr, std::optional<reg_t> asid);
+
+  // hfence.gvma: drop guest translations through the G-stage mapping of
+  // gaddr, of the given guest, unless either is not given
+  void flush_tlb_gvma(std::optional<reg_t> gaddr, std::optional<reg_t> vmid);
+
   void register_memtracer(memtracer_t*);
 
   int is_misaligned_enabled()
@@ -345,6 +529,13 @@ public:
     return proc && proc->get_cfg().misaligned;
   }
 
+  // a misaligned access that the TLB can satisfy directly: misaligned
+  // accesses are allowed and this one doesn't cross into the next page
+  bool misaligned_fast_ok(reg_t addr, reg_t len)
+  {
+    return (addr % PGSIZE) + len <= PGSIZE && is_misaligned_enabled();
+  }
+
   bool is_target_big_endian()
   {
     return target_big_endian;
@@ -365,16 +556,45 @@ public:
     blocksz = size;
   }
 
+  // are other harts running concurrently on other host threads?
+  void set_concurrent(bool value)
+  {
+    concurrent = value;
+  }
+
+  // While a hart runs privately, the first store to each page copies it,
+  // and the hart then reads and writes its own copy, so that neither other
+  // harts' stores nor the order in which harts run affect what it reads.
+  // Accesses that would be seen outside the hart straight away (MMIO,
+  // AMOs, store-conditionals) throw defer_access_t instead.  Leaving private
+  // mode discards the copies, so the caller must first write them back.
+  void set_private(bool value);
+  const std::map<char*, char*>& get_private_pages() { return private_pages; }
+
+  // did the hart stop running privately to defer an access?
+  bool take_deferred_access()
+  {
+    bool res = deferred_access;
+    deferred_access = false;
+    return res;
+  }
+
 private:
   simif_t* sim;
   processor_t* proc;
   memtracer_list_t tracer;
   reg_t load_reservation_address;
+  reg_t load_reservation_value;
+  bool concurrent;
+  bool private_view;
+  bool deferred_access;
+  std::map<char*, char*> private_pages; // shared page -> private copy
+  std::vector<char*> spare_pages;
   uint16_t fetch_temp;
   reg_t blocksz;
 
-  // implement an instruction cache for simulator performance
-  icache_entry_t icache[ICACHE_ENTRIES];
+  // implement a cache of decoded basic blocks for simulator performance
+  insn_block_t block_cache[BLOCK_CACHE_ENTRIES];
 
   // implement a TLB for simulator performance
   static const reg_t TLB_ENTRIES = 256;
@@ -386,10 +606,69 @@ private:
   reg_t tlb_load_tag[TLB_ENTRIES];
   reg_t tlb_store_tag[TLB_ENTRIES];
 
+  // a TLB of device pages, tagged like the above
+  tlb_mmio_entry_t tlb_mmio_data[TLB_ENTRIES];
+  reg_t tlb_mmio_load_tag[TLB_ENTRIES];
+  reg_t tlb_mmio_store_tag[TLB_ENTRIES];
+
+  // second-level TLB, consulted by walk(): tlb_l2_ways entries per set
+  std::vector<tlb_l2_entry_t> tlb_l2;
+  std::vector<size_t> tlb_l2_victim; // next way to replace, per set
+  size_t tlb_l2_sets;
+  size_t tlb_l2_ways;
+  tlb_l2_entry_t* tlb_l2_set(const tlb_l2_entry_t& entry)
+  {
+    return &tlb_l2[((entry.vpn ^ entry.satp ^ entry.hgatp) & (tlb_l2_sets - 1)) * tlb_l2_ways];
+  }
+  std::optional<reg_t> tlb_l2_lookup(const tlb_l2_entry_t& tag, access_type type);
+  void tlb_l2_insert(tlb_l2_entry_t entry, access_type type);
+
+  // page-walk cache, which lets walk() skip the upper levels of page table
+  static const reg_t PWC_ENTRIES = 256;
+  pwc_entry_t pwc[PWC_ENTRIES];
+  pwc_entry_t* pwc_slot(reg_t vpn, int level, reg_t satp, reg_t hgatp, unsigned span)
+  {
+    return &pwc[((vpn >> span) * 5 + level + satp + hgatp) % PWC_ENTRIES];
+  }
+
+  // G-stage TLB, consulted by s2xlate()
+  static const reg_t GSTAGE_ENTRIES = 256;
+  gstage_entry_t gstage_tlb[GSTAGE_ENTRIES];
+
+  // hit/miss counts, reported with --tlb-stats
+  uint64_t tlb_l2_hits = 0;
+  uint64_t tlb_l2_misses = 0;
+  uint64_t pwc_hits = 0;
+  uint64_t pwc_misses = 0;
+  uint64_t gstage_hits = 0;
+  uint64_t gstage_misses = 0;
+
+  // can the block starting at block_pc be extended with the instruction at pc?
+  bool block_extendable(reg_t block_pc, reg_t pc);
+
+  // host address of paddr, if it is memory, as this hart should see it
+  char* host_addr(reg_t paddr, access_type type);
+  void flush_tlb_host_pages(const std::function<bool(const char*)>& match);
+  [[noreturn]] void defer_access();
+
   // finish translation on a TLB miss and update the TLB
   tlb_entry_t refill_tlb(reg_t vaddr, reg_t paddr, char* host_addr, access_type type);
+  void refill_tlb_mmio(reg_t vaddr, reg_t paddr, access_type type);
+  // a device access the TLB of device pages can make
+  static bool mmio_tlb_ok(reg_t addr, reg_t len) {
+    return (len & (len - 1)) == 0 && (addr & (len - 1)) == 0;
+  }
   const char* fill_from_mmio(reg_t vaddr, reg_t paddr);
 
+  char* ALWAYS_INLINE bulk_host_ptr(reg_t addr, reg_t elt_size, const reg_t* tags) {
+    reg_t vpn = addr >> PGSHIFT;
+    if (unlikely(tags[vpn % TLB_ENTRIES] != vpn || target_big_endian ||
+                 ((addr & (elt_size - 1)) != 0 && !is_misaligned_enabled()) ||
+                 (proc && proc->get_log_commits_enabled())))
+      return NULL;
+    return tlb_data[vpn % TLB_ENTRIES].host_offset + addr;
+  }
+
   // perform a stage2 translation for a given guest address
   reg_t s2xlate(reg_t gva, reg_t gpa, access_type type, access_type trap_type, bool virt, bool hlvx);
 
@@ -434,7 +713,7 @@ private:
     if (!pmp_ok(pte_paddr, ptesize, LOAD, PRV_S))
       throw_access_exception(virt, addr, trap_type);
 
-    void* host_pte_addr = sim->addr_to_mem(pte_paddr);
+    void* host_pte_addr = host_addr(pte_paddr, LOAD);
     target_endian<T> target_pte;
     if (host_pte_addr) {
       memcpy(&target_pte, host_pte_addr, ptesize);
@@ -451,7 +730,7 @@ private:
     if (!pmp_ok(pte_paddr, ptesize, STORE, PRV_S))
       throw_access_exception(virt, addr, trap_type);
 
-    void* host_pte_addr = sim->addr_to_mem(pte_paddr);
+    void* host_pte_addr = host_addr(pte_paddr, STORE);
     target_endian<T> target_pte = to_target((T)new_pte);
     if (host_pte_addr) {
       memcpy(host_pte_addr, &target_pte, ptesize);
@@ -495,6 +774,7 @@ private:
   triggers::matched_t *matched_trigger;
 
   friend class processor_t;
+  friend class jit_t;
 };
 
 struct vm_info {
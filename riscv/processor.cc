@@ -8,6 +8,7 @@
 #include "decode_macros.h"
 #include "simif.h"
 #include "mmu.h"
+#include "jit.h"
 #include "disasm.h"
 #include "platform.h"
 #include "vector_unit.h"
@@ -21,6 +22,7 @@
 #include <stdexcept>
 #include <string>
 #include <algorithm>
+#include <mutex>
 
 #ifdef __GNUC__
 # pragma GCC diagnostic ignored "-Wunused-variable"
@@ -29,6 +31,8 @@
 #undef STATE
 #define STATE state
 
+static std::vector<insn_desc_t> base_instructions(const isa_parser_t* isa);
+
 processor_t::processor_t(const isa_parser_t *isa, const cfg_t *cfg,
                          simif_t* sim, uint32_t id, bool halt_on_reset,
                          FILE* log_file, std::ostream& sout_)
@@ -56,9 +60,22 @@ processor_t::processor_t(const isa_parser_t *isa, const cfg_t *cfg,
 
   parse_varch_string(cfg->varch());
 
-  register_base_instructions();
+  // the base instructions depend only on the ISA string
+  decode_table_key = isa->get_isa_string();
+  decode_table = decode_table_t::get(decode_table_key, [&] { return base_instructions(isa); });
   mmu = new mmu_t(sim, cfg->endianness, this);
 
+  pending_trap = NULL;
+
+  jit = NULL;
+  if (cfg->jit) {
+    if (!jit_t::host_supported()) {
+      fprintf(stderr, "--jit is not supported on this host\n");
+      abort();
+    }
+    jit = new jit_t(this);
+  }
+
   disassembler = new disassembler_t(isa);
   for (auto e : isa->get_extensions())
     register_extension(find_extension(e.c_str())());
@@ -90,6 +107,7 @@ processor_t::~processor_t()
       fprintf(stderr, "%0" PRIx64 " %" PRIu64 "\n", it.first, it.second);
   }
 
+  delete jit;
   delete mmu;
   delete disassembler;
 }
@@ -611,6 +629,9 @@ void processor_t::set_histogram(bool value)
 void processor_t::enable_log_commits()
 {
   log_commits_enabled = true;
+
+  // cached instructions decoded to their unlogged routines
+  mmu->flush_icache();
 }
 
 void processor_t::reset()
@@ -782,7 +803,7 @@ reg_t processor_t::legalize_privilege(reg_t prv)
 
 void processor_t::set_privilege(reg_t prv, bool virt)
 {
-  mmu->flush_tlb();
+  mmu->switch_tlb_context();
   state.prev_prv = state.prv;
   state.prev_v = state.v;
   state.prv = legalize_privilege(prv);
@@ -934,6 +955,14 @@ void processor_t::take_trap(trap_t& t, reg_t epc)
   }
 }
 
+void processor_t::take_pending_trap(reg_t epc)
+{
+  trap_t* t = pending_trap;
+  pending_trap = NULL;
+  deliver_trap(*t, epc);
+  t->~trap_t();
+}
+
 void processor_t::take_trigger_action(triggers::action_t action, reg_t breakpoint_tval, reg_t epc, bool virt)
 {
   if (debug) {
@@ -1030,55 +1059,26 @@ reg_t processor_t::get_csr(int which, insn_t insn, bool write, bool peek)
   throw trap_illegal_instruction(insn.bits());
 }
 
-reg_t illegal_instruction(processor_t UNUSED *p, insn_t insn, reg_t UNUSED pc)
+reg_t illegal_instruction(processor_t *p, insn_t insn, reg_t UNUSED pc)
 {
   // The illegal instruction can be longer than ILEN bits, where the tval will
   // contain the first ILEN bits of the faulting instruction. We hard-code the
   // ILEN to 32 bits since all official instructions have at most 32 bits.
-  throw trap_illegal_instruction(insn.bits() & 0xffffffffULL);
+  p->set_pending_trap(trap_illegal_instruction(insn.bits() & 0xffffffffULL));
+  return PC_TRAP;
 }
 
 insn_func_t processor_t::decode_insn(insn_t insn)
 {
-  // look up opcode in hash table
-  size_t idx = insn.bits() % OPCODE_CACHE_SIZE;
-  insn_desc_t desc = opcode_cache[idx];
+  const insn_desc_t& desc = decode_table->lookup(insn.bits());
 
   bool rve = extension_enabled('E');
 
-  if (unlikely(insn.bits() != desc.match)) {
-    // fall back to linear search
-    int cnt = 0;
-    insn_desc_t* p = &instructions[0];
-    while ((insn.bits() & p->mask) != p->match)
-      p++, cnt++;
-    desc = *p;
-
-    if (p->mask != 0 && p > &instructions[0]) {
-      if (p->match != (p - 1)->match && p->match != (p + 1)->match) {
-        // move to front of opcode list to reduce miss penalty
-        while (--p >= &instructions[0])
-          *(p + 1) = *p;
-        instructions[0] = desc;
-      }
-    }
-
-    opcode_cache[idx] = desc;
-    opcode_cache[idx].match = insn.bits();
-  }
-
   return desc.func(xlen, rve, log_commits_enabled);
 }
 
-void processor_t::register_insn(insn_desc_t desc)
-{
-  assert(desc.fast_rv32i && desc.fast_rv64i && desc.fast_rv32e && desc.fast_rv64e &&
-         desc.logged_rv32i && desc.logged_rv64i && desc.logged_rv32e && desc.logged_rv64e);
-
-  instructions.push_back(desc);
-}
-
-void processor_t::build_opcode_map()
+decode_table_t::decode_table_t(std::vector<insn_desc_t> instructions)
+  : instructions(std::move(instructions))
 {
   struct cmp {
     bool operator()(const insn_desc_t& lhs, const insn_desc_t& rhs) {
@@ -1087,17 +1087,65 @@ void processor_t::build_opcode_map()
       return lhs.match > rhs.match;
     }
   };
-  std::sort(instructions.begin(), instructions.end(), cmp());
+  std::sort(this->instructions.begin(), this->instructions.end(), cmp());
+
+  std::vector<decode_tree_t::pattern_t> patterns;
+  for (auto& insn : this->instructions)
+    patterns.push_back({insn.match, insn.mask});
+  tree.build(patterns);
+}
+
+std::shared_ptr<const decode_table_t>
+decode_table_t::get(const std::string& key, std::function<std::vector<insn_desc_t>()> make)
+{
+  if (key.empty())
+    return std::make_shared<const decode_table_t>(make());
+
+  // tables are freed along with the last hart that uses them
+  static std::mutex tables_lock;
+  static std::map<std::string, std::weak_ptr<const decode_table_t>> tables;
+
+  std::lock_guard<std::mutex> guard(tables_lock);
+  auto& entry = tables[key];
+  auto table = entry.lock();
+  if (!table)
+    entry = table = std::make_shared<const decode_table_t>(make());
+  return table;
+}
 
-  for (size_t i = 0; i < OPCODE_CACHE_SIZE; i++)
-    opcode_cache[i] = insn_desc_t::illegal();
+static void check_insn_desc(const insn_desc_t& desc)
+{
+  assert(desc.fast_rv32i && desc.fast_rv64i && desc.fast_rv32e && desc.fast_rv64e &&
+         desc.logged_rv32i && desc.logged_rv64i && desc.logged_rv32e && desc.logged_rv64e);
+}
+
+void processor_t::register_insn(insn_desc_t desc)
+{
+  check_insn_desc(desc);
+
+  // no other hart is known to decode desc, so stop sharing our table
+  std::vector<insn_desc_t> instructions = decode_table->get_instructions();
+  instructions.push_back(desc);
+  decode_table_key.clear();
+  decode_table = decode_table_t::get(decode_table_key, [&] { return instructions; });
 }
 
 void processor_t::register_extension(extension_t* x)
 {
-  for (auto insn : x->get_instructions())
-    register_insn(insn);
-  build_opcode_map();
+  std::vector<insn_desc_t> extension_instructions = x->get_instructions();
+  for (auto& insn : extension_instructions)
+    check_insn_desc(insn);
+
+  // extensions are assumed to decode the same instructions as any other
+  // extension with the same name
+  if (!decode_table_key.empty())
+    decode_table_key += std::string("+") + x->name();
+  auto base = decode_table;
+  decode_table = decode_table_t::get(decode_table_key, [&] {
+    std::vector<insn_desc_t> instructions = base->get_instructions();
+    instructions.insert(instructions.end(), extension_instructions.begin(), extension_instructions.end());
+    return instructions;
+  });
 
   for (auto disasm_insn : x->get_disasms())
     disassembler->add_insn(disasm_insn);
@@ -1109,7 +1157,7 @@ void processor_t::register_extension(extension_t* x)
   x->set_processor(this);
 }
 
-void processor_t::register_base_instructions()
+static std::vector<insn_desc_t> base_instructions(const isa_parser_t* isa)
 {
   #define DECLARE_INSN(name, match, mask) \
     insn_bits_t name##_match = (match), name##_mask = (mask); \
@@ -1122,6 +1170,7 @@ void processor_t::register_base_instructions()
   #include "overlap_list.h"
   #undef DECLARE_OVERLAP_INSN
 
+  std::vector<insn_desc_t> instructions;
   #define DEFINE_INSN(name) \
     extern reg_t fast_rv32i_##name(processor_t*, insn_t, reg_t); \
     extern reg_t fast_rv64i_##name(processor_t*, insn_t, reg_t); \
@@ -1132,7 +1181,7 @@ void processor_t::register_base_instructions()
     extern reg_t logged_rv32e_##name(processor_t*, insn_t, reg_t); \
     extern reg_t logged_rv64e_##name(processor_t*, insn_t, reg_t); \
     if (name##_supported) { \
-      register_insn((insn_desc_t) { \
+      instructions.push_back((insn_desc_t) { \
         name##_match, \
         name##_mask, \
         fast_rv32i_##name, \
@@ -1148,9 +1197,9 @@ void processor_t::register_base_instructions()
   #undef DEFINE_INSN
 
   // terminate instruction list with a catch-all
-  register_insn(insn_desc_t::illegal());
+  instructions.push_back(insn_desc_t::illegal());
 
-  build_opcode_map();
+  return instructions;
 }
 
 bool processor_t::load(reg_t addr, size_t len, uint8_t* bytes)
@@ -3,13 +3,17 @@
 #define _RISCV_PROCESSOR_H
 
 #include "decode.h"
+#include "decode_tree.h"
 #include "trap.h"
 #include "abstract_device.h"
 #include <string>
 #include <vector>
 #include <unordered_map>
 #include <map>
+#include <memory>
+#include <functional>
 #include <cassert>
+#include <new>
 #include "debug_rom_defines.h"
 #include "entropy_source.h"
 #include "csrs.h"
@@ -22,6 +26,7 @@
 
 class processor_t;
 class mmu_t;
+class jit_t;
 typedef reg_t (*insn_func_t)(processor_t*, insn_t, reg_t);
 class simif_t;
 class trap_t;
@@ -43,7 +48,7 @@ struct insn_desc_t
   insn_func_t logged_rv32e;
   insn_func_t logged_rv64e;
 
-  insn_func_t func(int xlen, bool rve, bool logged)
+  insn_func_t func(int xlen, bool rve, bool logged) const
   {
     if (logged)
       if (rve)
@@ -65,6 +70,31 @@ struct insn_desc_t
   }
 };
 
+// The instructions a hart can decode, in decode order, and a decode tree
+// over them.  Tables are immutable once built, so harts with the same ISA
+// and extensions share one instead of each building their own.
+class decode_table_t
+{
+public:
+  decode_table_t(std::vector<insn_desc_t> instructions);
+
+  const insn_desc_t& lookup(insn_bits_t bits) const
+  {
+    return instructions[tree.lookup(bits)];
+  }
+
+  const std::vector<insn_desc_t>& get_instructions() const { return instructions; }
+
+  // The table named key, built from the instructions make returns unless a
+  // hart already holds it.  An empty key names a table that is never shared.
+  static std::shared_ptr<const decode_table_t>
+  get(const std::string& key, std::function<std::vector<insn_desc_t>()> make);
+
+private:
+  std::vector<insn_desc_t> instructions;
+  decode_tree_t tree;
+};
+
 // regnum, data
 typedef std::unordered_map<reg_t, freg_t> commit_log_reg_t;
 
@@ -304,6 +334,15 @@ public:
 
   const char* get_symbol(uint64_t addr);
 
+  // Leaves t to be taken once the running instruction's routine returns
+  // PC_TRAP (see raise_trap), so that common traps don't unwind the stack.
+  template<typename T> void set_pending_trap(const T& t)
+  {
+    static_assert(sizeof(T) <= sizeof(pending_trap_storage) && alignof(T) <= alignof(mem_trap_t),
+                  "pending trap storage too small");
+    pending_trap = new (pending_trap_storage) T(t);
+  }
+
   void clear_waiting_for_interrupt() { in_wfi = false; };
   bool is_waiting_for_interrupt() { return in_wfi; };
 
@@ -313,6 +352,7 @@ private:
 
   simif_t* sim;
   mmu_t* mmu; // main memory is always accessed via the mmu
+  jit_t* jit; // translates hot blocks to host code, if enabled
   std::unordered_map<std::string, extension_t*> custom_extensions;
   disassembler_t* disassembler;
   state_t state;
@@ -324,6 +364,8 @@ private:
   std::ostream sout_; // needed for socket command interface -s, also used for -d and -l, but not for --log
   bool halt_on_reset;
   bool in_wfi;
+  trap_t* pending_trap;
+  alignas(mem_trap_t) char pending_trap_storage[sizeof(mem_trap_t)];
   bool check_triggers_icount;
   std::vector<bool> impl_table;
 
@@ -332,15 +374,15 @@ private:
   std::bitset<NUM_ISA_EXTENSIONS> extension_dynamic;
   mutable std::bitset<NUM_ISA_EXTENSIONS> extension_assumed_const;
 
-  std::vector<insn_desc_t> instructions;
+  std::shared_ptr<const decode_table_t> decode_table;
+  std::string decode_table_key; // empty once this hart's table is its own
   std::unordered_map<reg_t,uint64_t> pc_histogram;
 
-  static const size_t OPCODE_CACHE_SIZE = 8191;
-  insn_desc_t opcode_cache[OPCODE_CACHE_SIZE];
-
   void take_pending_interrupt() { take_interrupt(state.mip->read() & state.mie->read()); }
   void take_interrupt(reg_t mask); // take first enabled interrupt in mask
   void take_trap(trap_t& t, reg_t epc); // take an exception
+  void deliver_trap(trap_t& t, reg_t epc); // take an exception and any action that follows it
+  void take_pending_trap(reg_t epc);
   void take_trigger_action(triggers::action_t action, reg_t breakpoint_tval, reg_t epc, bool virt);
   void disasm(insn_t insn); // disassemble and print an instruction
   int paddr_bits();
@@ -356,8 +398,6 @@ private:
 
   void parse_varch_string(const char*);
   void parse_priv_string(const char*);
-  void build_opcode_map();
-  void register_base_instructions();
   insn_func_t decode_insn(insn_t insn);
 
   // Track repeated executions for processor_t::disasm()
@@ -60,6 +60,9 @@ sim_t::sim_t(const cfg_t *cfg, bool halted,
     histogram_enabled(false),
     log(false),
     remote_bitbang(NULL),
+    rounds_started(0),
+    workers_running(0),
+    workers_exiting(false),
     debug_module(this, dm_config)
 {
   signal(SIGINT, &handle_signal);
@@ -238,6 +241,14 @@ sim_t::sim_t(const cfg_t *cfg, bool halted,
 
 sim_t::~sim_t()
 {
+  {
+    std::lock_guard<std::mutex> guard(workers_lock);
+    workers_exiting = true;
+  }
+  round_started.notify_all();
+  for (auto& worker : workers)
+    worker.join();
+
   for (size_t i = 0; i < procs.size(); i++)
     delete procs[i];
   delete debug_mmu;
@@ -269,13 +280,170 @@ void sim_t::step(size_t n)
       procs[current_proc]->get_mmu()->yield_load_reservation();
       if (++current_proc == procs.size()) {
         current_proc = 0;
-        reg_t rtc_ticks = INTERLEAVE / INSNS_PER_RTC_TICK;
+        reg_t rtc_ticks = std::max(INTERLEAVE / INSNS_PER_RTC_TICK, idle_rtc_ticks());
         for (auto &dev : devices) dev->tick(rtc_ticks);
       }
     }
   }
 }
 
+// If every hart is waiting for an interrupt, returns the number of RTC ticks
+// until the earliest timer interrupt that one of them has enabled, so that
+// time can jump straight there instead of being stepped through one quantum
+// at a time.  Returns 0 if time must not be skipped.
+reg_t sim_t::idle_rtc_ticks()
+{
+  if (!cfg->skip_idle || !clint || cfg->real_time_clint() || remote_bitbang)
+    return 0;
+
+  reg_t mtime = clint->get_mtime();
+  reg_t wakeup = UINT64_MAX;
+  for (auto p : procs) {
+    if (!p->is_waiting_for_interrupt())
+      return 0;
+
+    state_t* state = p->get_state();
+    reg_t mie = state->mie->read();
+    if (state->mip->read() & mie)
+      return 0;
+
+    if (mie & MIP_MTIP)
+      wakeup = std::min(wakeup, clint->get_mtimecmp(p->get_id()));
+    if (p->extension_enabled(EXT_SSTC)) {
+      if (mie & MIP_STIP)
+        wakeup = std::min(wakeup, state->stimecmp->read());
+      if (mie & MIP_VSTIP)
+        wakeup = std::min(wakeup, state->vstimecmp->read() - state->htimedelta->read());
+    }
+  }
+
+  // Device interrupts, such as UART input, are asynchronous to target time,
+  // so only a timer bounds the skip.
+  if (wakeup == UINT64_MAX || wakeup <= mtime)
+    return 0;
+  return wakeup - mtime;
+}
+
+bool sim_t::parallel()
+{
+  // logs and histograms are only kept coherent by running harts in turn
+  return (cfg->threads > 1 || cfg->deterministic) && procs.size() > 1 &&
+         !log && !histogram_enabled &&
+         !procs[0]->get_log_commits_enabled();
+}
+
+// Runs every hart for one quantum, with hart i on host thread i % threads,
+// then lets devices catch up.  Harts on different threads share memory
+// directly: AMOs and LR/SC use host atomics (see mmu_t::set_concurrent),
+// and device accesses are serialized by bus_lock.
+//
+// With --deterministic, harts instead run privately (see mmu_t::set_private)
+// and their stores are merged afterwards, and a hart that needs to touch a
+// device or make an atomic access stops for the rest of the quantum and
+// makes it once the others have finished, in hart order.  Runs then depend
+// only on the quantum, not on --threads or on host timing.
+void sim_t::step_parallel()
+{
+  if (workers.empty()) {
+    for (auto p : procs)
+      p->get_mmu()->set_concurrent(true);
+    size_t groups = std::min(cfg->threads, procs.size());
+    for (size_t group = 1; group < groups; group++)
+      workers.emplace_back(&sim_t::run_worker, this, group);
+  }
+
+  if (cfg->deterministic) {
+    for (auto p : procs)
+      p->get_mmu()->set_private(true);
+  }
+
+  size_t quantum = cfg->quantum.value_or(INTERLEAVE);
+  {
+    std::lock_guard<std::mutex> guard(workers_lock);
+    rounds_started++;
+    workers_running = workers.size();
+  }
+  round_started.notify_all();
+
+  step_group(0, quantum);
+
+  {
+    std::unique_lock<std::mutex> guard(workers_lock);
+    round_finished.wait(guard, [&] { return workers_running == 0; });
+  }
+
+  if (cfg->deterministic) {
+    merge_private_pages();
+    for (auto p : procs) {
+      if (p->get_mmu()->take_deferred_access())
+        p->step(1);
+    }
+  }
+
+  reg_t rtc_ticks = std::max(quantum / INSNS_PER_RTC_TICK, idle_rtc_ticks());
+  for (auto &dev : devices) dev->tick(rtc_ticks);
+}
+
+// Writes back the pages harts copied while running privately.  Where several
+// harts wrote the same page, each byte takes the value written by the
+// highest-numbered hart that changed it, so that the result doesn't depend
+// on which host threads ran which harts, or when.
+void sim_t::merge_private_pages()
+{
+  std::map<char*, std::vector<const char*>> writers;
+  for (auto p : procs) {
+    for (auto [shared, copy] : p->get_mmu()->get_private_pages())
+      writers[shared].push_back(copy);
+  }
+
+  char merged[PGSIZE];
+  for (auto& [shared, copies] : writers) {
+    if (copies.size() == 1) {
+      memcpy(shared, copies[0], PGSIZE);
+      continue;
+    }
+
+    memcpy(merged, shared, PGSIZE);
+    for (auto copy : copies) {
+      for (size_t i = 0; i < PGSIZE; i++) {
+        if (copy[i] != shared[i])
+          merged[i] = copy[i];
+      }
+    }
+    memcpy(shared, merged, PGSIZE);
+  }
+
+  for (auto p : procs)
+    p->get_mmu()->set_private(false);
+}
+
+void sim_t::step_group(size_t group, size_t n)
+{
+  // Unlike in step(), reservations needn't be yielded between quanta, since
+  // concurrent harts' store conditionals check the reserved value.
+  for (size_t i = group; i < procs.size(); i += workers.size() + 1)
+    procs[i]->step(n);
+}
+
+void sim_t::run_worker(size_t group)
+{
+  uint64_t rounds = 0;
+  std::unique_lock<std::mutex> guard(workers_lock);
+  while (true) {
+    round_started.wait(guard, [&] { return rounds_started != rounds || workers_exiting; });
+    if (workers_exiting)
+      return;
+    rounds = rounds_started;
+
+    guard.unlock();
+    step_group(group, cfg->quantum.value_or(INTERLEAVE));
+    guard.lock();
+
+    if (--workers_running == 0)
+      round_finished.notify_one();
+  }
+}
+
 void sim_t::add_device(reg_t addr, std::shared_ptr<abstract_device_t> dev) {
   bus.add_device(addr, dev.get());
   devices.push_back(dev);
@@ -321,6 +489,7 @@ bool sim_t::mmio_load(reg_t paddr, size_t len, uint8_t* bytes)
 {
   if (paddr + len < paddr || !paddr_ok(paddr + len - 1))
     return false;
+  std::lock_guard<std::recursive_mutex> guard(bus_lock);
   return bus.load(paddr, len, bytes);
 }
 
@@ -328,9 +497,31 @@ bool sim_t::mmio_store(reg_t paddr, size_t len, const uint8_t* bytes)
 {
   if (paddr + len < paddr || !paddr_ok(paddr + len - 1))
     return false;
+  std::lock_guard<std::recursive_mutex> guard(bus_lock);
   return bus.store(paddr, len, bytes);
 }
 
+abstract_device_t* sim_t::mmio_device(reg_t paddr, reg_t len, reg_t* offset)
+{
+  if (paddr + len < paddr || !paddr_ok(paddr + len - 1))
+    return NULL;
+  auto [base, dev] = bus.find_mmio_device(paddr, len);
+  *offset = paddr - base;
+  return dev;
+}
+
+bool sim_t::mmio_device_load(abstract_device_t* dev, reg_t offset, size_t len, uint8_t* bytes)
+{
+  std::lock_guard<std::recursive_mutex> guard(bus_lock);
+  return dev->load(offset, len, bytes);
+}
+
+bool sim_t::mmio_device_store(abstract_device_t* dev, reg_t offset, size_t len, const uint8_t* bytes)
+{
+  std::lock_guard<std::recursive_mutex> guard(bus_lock);
+  return dev->store(offset, len, bytes);
+}
+
 void sim_t::set_rom()
 {
   const int reset_vec_size = 8;
@@ -379,11 +570,8 @@ void sim_t::set_rom()
 char* sim_t::addr_to_mem(reg_t paddr) {
   if (!paddr_ok(paddr))
     return NULL;
-  auto desc = bus.find_device(paddr);
-  if (auto mem = dynamic_cast<abstract_mem_t*>(desc.second))
-    if (paddr - desc.first < mem->size())
-      return mem->contents(paddr - desc.first);
-  return NULL;
+  auto [base, mem] = bus.find_mem(paddr);
+  return mem ? mem->contents(paddr - base) : NULL;
 }
 
 const char* sim_t::get_symbol(uint64_t paddr)
@@ -406,6 +594,8 @@ void sim_t::idle()
 
   if (debug || ctrlc_pressed)
     interactive();
+  else if (parallel())
+    step_parallel();
   else
     step(INTERLEAVE);
 
@@ -413,19 +603,54 @@ void sim_t::idle()
     remote_bitbang->tick();
 }
 
+// Chunks are copied to and from memory a page at a time; devices see the
+// debug MMU's 8-byte accesses, as they would from a hart.
+
 void sim_t::read_chunk(addr_t taddr, size_t len, void* dst)
 {
-  assert(len == 8);
-  auto data = debug_mmu->to_target(debug_mmu->load<uint64_t>(taddr));
-  memcpy(dst, &data, sizeof data);
+  assert(taddr % 8 == 0 && len % 8 == 0);
+  for (size_t n; len > 0; taddr += n, dst = (char*)dst + n, len -= n) {
+    n = std::min(len, size_t(PGSIZE - taddr % PGSIZE));
+    if (char* host = addr_to_mem(taddr)) {
+      memcpy(dst, host, n);
+      continue;
+    }
+    for (size_t i = 0; i < n; i += 8) {
+      auto data = debug_mmu->to_target(debug_mmu->load<uint64_t>(taddr + i));
+      memcpy((char*)dst + i, &data, sizeof data);
+    }
+  }
 }
 
 void sim_t::write_chunk(addr_t taddr, size_t len, const void* src)
 {
-  assert(len == 8);
-  target_endian<uint64_t> data;
-  memcpy(&data, src, sizeof data);
-  debug_mmu->store<uint64_t>(taddr, debug_mmu->from_target(data));
+  assert(taddr % 8 == 0 && len % 8 == 0);
+  for (size_t n; len > 0; taddr += n, src = (const char*)src + n, len -= n) {
+    n = std::min(len, size_t(PGSIZE - taddr % PGSIZE));
+    if (char* host = addr_to_mem(taddr)) {
+      memcpy(host, src, n);
+      continue;
+    }
+    for (size_t i = 0; i < n; i += 8) {
+      target_endian<uint64_t> data;
+      memcpy(&data, (const char*)src + i, sizeof data);
+      debug_mmu->store<uint64_t>(taddr + i, debug_mmu->from_target(data));
+    }
+  }
+}
+
+void sim_t::clear_chunk(addr_t taddr, size_t len)
+{
+  assert(taddr % 8 == 0 && len % 8 == 0);
+  for (size_t n; len > 0; taddr += n, len -= n) {
+    n = std::min(len, size_t(PGSIZE - taddr % PGSIZE));
+    if (char* host = addr_to_mem(taddr)) {
+      memset(host, 0, n);
+      continue;
+    }
+    for (size_t i = 0; i < n; i += 8)
+      debug_mmu->store<uint64_t>(taddr + i, 0);
+  }
 }
 
 endianness_t sim_t::get_target_endianness() const
@@ -15,6 +15,9 @@
 #include <map>
 #include <string>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
 #include <sys/types.h>
 
 class mmu_t;
@@ -88,18 +91,42 @@ private:
 
   processor_t* get_core(const std::string& i);
   void step(size_t n); // step through simulation
+  reg_t idle_rtc_ticks(); // RTC ticks that may be skipped while all harts idle
+  bool parallel(); // may harts run concurrently on several host threads?
+  void step_parallel(); // step every hart by one quantum, concurrently
+  void step_group(size_t group, size_t n); // step one host thread's harts
+  void run_worker(size_t group);
+  void merge_private_pages(); // after a deterministic round
   size_t current_step;
   size_t current_proc;
   bool debug;
   bool histogram_enabled; // provide a histogram of PCs
   bool log;
   remote_bitbang_t* remote_bitbang;
+
+  // host threads that run all but the first group of harts in parallel mode;
+  // the simulation thread itself runs the first group
+  std::vector<std::thread> workers;
+  std::mutex workers_lock;
+  std::condition_variable round_started;
+  std::condition_variable round_finished;
+  uint64_t rounds_started;
+  size_t workers_running;
+  bool workers_exiting;
+
+  // serializes device accesses from concurrent harts.  Recursive because
+  // some devices access the bus themselves (e.g. debug module system bus
+  // access).
+  std::recursive_mutex bus_lock;
   std::optional<std::function<void()>> next_interactive_action;
 
   // memory-mapped I/O routines
   virtual char* addr_to_mem(reg_t paddr) override;
   virtual bool mmio_load(reg_t paddr, size_t len, uint8_t* bytes) override;
   virtual bool mmio_store(reg_t paddr, size_t len, const uint8_t* bytes) override;
+  virtual abstract_device_t* mmio_device(reg_t paddr, reg_t len, reg_t* offset) override;
+  virtual bool mmio_device_load(abstract_device_t* dev, reg_t offset, size_t len, uint8_t* bytes) override;
+  virtual bool mmio_device_store(abstract_device_t* dev, reg_t offset, size_t len, const uint8_t* bytes) override;
   void set_rom();
 
   virtual const char* get_symbol(uint64_t paddr) override;
@@ -142,8 +169,9 @@ private:
   virtual void idle() override;
   virtual void read_chunk(addr_t taddr, size_t len, void* dst) override;
   virtual void write_chunk(addr_t taddr, size_t len, const void* src) override;
+  virtual void clear_chunk(addr_t taddr, size_t len) override;
   virtual size_t chunk_align() override { return 8; }
-  virtual size_t chunk_max_size() override { return 8; }
+  virtual size_t chunk_max_size() override { return 1 << 20; }
   virtual endianness_t get_target_endianness() const override;
 
 public:
@@ -6,6 +6,7 @@
 #include <map>
 #include "decode.h"
 #include "cfg.h"
+#include "abstract_device.h"
 
 class processor_t;
 class mmu_t;
@@ -21,6 +22,12 @@ public:
   virtual bool mmio_fetch(reg_t paddr, size_t len, uint8_t* bytes) { return mmio_load(paddr, len, bytes); }
   virtual bool mmio_load(reg_t paddr, size_t len, uint8_t* bytes) = 0;
   virtual bool mmio_store(reg_t paddr, size_t len, const uint8_t* bytes) = 0;
+  // The device serving all of [paddr, paddr + len), if there is one, and
+  // paddr's offset within it, so that MMUs can skip finding it again.
+  // Accesses to it must go through mmio_device_load and mmio_device_store.
+  virtual abstract_device_t* mmio_device(reg_t UNUSED paddr, reg_t UNUSED len, reg_t UNUSED* offset) { return NULL; }
+  virtual bool mmio_device_load(abstract_device_t* dev, reg_t offset, size_t len, uint8_t* bytes) { return dev->load(offset, len, bytes); }
+  virtual bool mmio_device_store(abstract_device_t* dev, reg_t offset, size_t len, const uint8_t* bytes) { return dev->store(offset, len, bytes); }
   // Callback for processors to let the simulation know they were reset.
   virtual void proc_reset(unsigned id) = 0;
 
@@ -660,169 +660,194 @@ static inline bool is_overlapped_widen(const int astart, int asize,
     REDUCTION_ULOOP(e64, BODY) \
   }
 
+//
+// vector: loops specialized to one SEW
+//
+// VI_SEW_LOOP dispatches on SEW once, outside the element loop, and indexes
+// spans of the register groups instead of calling P.VU.elt() per element.
+// Unmasked elements are done in fixed-size blocks staged through local
+// copies of the operands, a form the host compiler can vectorize.
+// OPERANDS(x, M) applies M to each register operand; PARAMS(x, from, n)
+// declares the operands of element n of the operand arrays named *from.
+#define VI_GROUP_BLOCK_BYTES 32
+
+#define VI_GROUP_DECL(type, name, num, is_write) \
+  auto name##_span = P.VU.elt_span<type>(num, vstart, vl, is_write);
+
+#define VI_GROUP_BLOCK_IN(type, name, num, is_write) \
+  type name##_block[block]; \
+  memcpy(name##_block, name##_span.data + i, sizeof(name##_block));
+
+#define VI_GROUP_BLOCK_OUT(type, name, num, is_write) \
+  if (is_write) \
+    memcpy(name##_span.data + i, name##_block, sizeof(name##_block));
+
+#define VI_GROUP_CONTIGUOUS(type, name, num, is_write) \
+  && vreg_span_t<type>::contiguous
+
+#define VV_OPERANDS(x, M) \
+  M(type_sew_t<x>::type, vd, rd_num, true) \
+  M(type_sew_t<x>::type, vs1, rs1_num, false) \
+  M(type_sew_t<x>::type, vs2, rs2_num, false)
+
+#define VX_OPERANDS(x, M) \
+  M(type_sew_t<x>::type, vd, rd_num, true) \
+  M(type_sew_t<x>::type, vs2, rs2_num, false)
+
+#define VI_OPERANDS(x, M) VX_OPERANDS(x, M)
+
+#define VV_U_OPERANDS(x, M) \
+  M(type_usew_t<x>::type, vd, rd_num, true) \
+  M(type_usew_t<x>::type, vs1, rs1_num, false) \
+  M(type_usew_t<x>::type, vs2, rs2_num, false)
+
+#define V_U_OPERANDS(x, M) \
+  M(type_usew_t<x>::type, vd, rd_num, true) \
+  M(type_usew_t<x>::type, vs2, rs2_num, false)
+
+#define VX_U_OPERANDS(x, M) V_U_OPERANDS(x, M)
+
+#define VI_U_OPERANDS(x, M) V_U_OPERANDS(x, M)
+
+#define VV_SU_OPERANDS(x, M) \
+  M(type_sew_t<x>::type, vd, rd_num, true) \
+  M(type_usew_t<x>::type, vs1, rs1_num, false) \
+  M(type_sew_t<x>::type, vs2, rs2_num, false)
+
+#define VX_SU_OPERANDS(x, M) VX_OPERANDS(x, M)
+
+#define VV_GROUP_PARAMS(x, from, n) \
+  type_sew_t<x>::type UNUSED &vd = vd##from[n]; \
+  type_sew_t<x>::type vs1 = vs1##from[n]; \
+  type_sew_t<x>::type UNUSED vs2 = vs2##from[n];
+
+#define VX_GROUP_PARAMS(x, from, n) \
+  type_sew_t<x>::type UNUSED &vd = vd##from[n]; \
+  type_sew_t<x>::type rs1 = (type_sew_t<x>::type)RS1; \
+  type_sew_t<x>::type UNUSED vs2 = vs2##from[n];
+
+#define VI_GROUP_PARAMS(x, from, n) \
+  type_sew_t<x>::type &vd = vd##from[n]; \
+  type_sew_t<x>::type simm5 = (type_sew_t<x>::type)insn.v_simm5(); \
+  type_sew_t<x>::type UNUSED vs2 = vs2##from[n];
+
+#define VV_U_GROUP_PARAMS(x, from, n) \
+  type_usew_t<x>::type &vd = vd##from[n]; \
+  type_usew_t<x>::type vs1 = vs1##from[n]; \
+  type_usew_t<x>::type vs2 = vs2##from[n];
+
+#define V_U_GROUP_PARAMS(x, from, n) \
+  type_usew_t<x>::type &vd = vd##from[n]; \
+  type_usew_t<x>::type vs2 = vs2##from[n];
+
+#define VX_U_GROUP_PARAMS(x, from, n) \
+  type_usew_t<x>::type &vd = vd##from[n]; \
+  type_usew_t<x>::type rs1 = (type_usew_t<x>::type)RS1; \
+  type_usew_t<x>::type vs2 = vs2##from[n];
+
+#define VI_U_GROUP_PARAMS(x, from, n) \
+  type_usew_t<x>::type &vd = vd##from[n]; \
+  type_usew_t<x>::type UNUSED zimm5 = (type_usew_t<x>::type)insn.v_zimm5(); \
+  type_usew_t<x>::type vs2 = vs2##from[n];
+
+#define VV_SU_GROUP_PARAMS(x, from, n) \
+  type_sew_t<x>::type &vd = vd##from[n]; \
+  type_usew_t<x>::type vs1 = vs1##from[n]; \
+  type_sew_t<x>::type vs2 = vs2##from[n];
+
+#define VX_SU_GROUP_PARAMS(x, from, n) \
+  type_sew_t<x>::type &vd = vd##from[n]; \
+  type_usew_t<x>::type rs1 = (type_usew_t<x>::type)RS1; \
+  type_sew_t<x>::type vs2 = vs2##from[n];
+
+#define VI_SEW_LOOP_BODY(x, OPERANDS, PARAMS, BODY) \
+  { \
+    OPERANDS(x, VI_GROUP_DECL) \
+    reg_t i = vstart; \
+    if (insn.v_vm() == 1 OPERANDS(x, VI_GROUP_CONTIGUOUS)) { \
+      constexpr reg_t block = VI_GROUP_BLOCK_BYTES / (x / 8); \
+      for (; i + block <= vl; i += block) { \
+        OPERANDS(x, VI_GROUP_BLOCK_IN) \
+        for (reg_t k = 0; k < block; ++k) { \
+          PARAMS(x, _block, k); \
+          BODY; \
+        } \
+        OPERANDS(x, VI_GROUP_BLOCK_OUT) \
+      } \
+    } \
+    auto v0_span = insn.v_vm() == 0 ? \
+      P.VU.elt_span<uint64_t>(0, vstart / 64, (vl + 63) / 64) : vreg_span_t<uint64_t>(); \
+    for (; i < vl; ++i) { \
+      VI_MASK_VARS \
+      if (insn.v_vm() == 0 && ((v0_span[midx] >> mpos) & 0x1) == 0) \
+        continue; \
+      PARAMS(x, _span, i); \
+      BODY; \
+    } \
+  }
+
+#define VI_SEW_LOOP(OPERANDS, PARAMS, BODY) \
+  require(P.VU.vsew >= e8 && P.VU.vsew <= e64); \
+  require_vector(true); \
+  reg_t vl = P.VU.vl->read(); \
+  reg_t UNUSED sew = P.VU.vsew; \
+  reg_t rd_num = insn.rd(); \
+  reg_t UNUSED rs1_num = insn.rs1(); \
+  reg_t rs2_num = insn.rs2(); \
+  reg_t vstart = P.VU.vstart->read(); \
+  switch (sew) { \
+  case e8: \
+    VI_SEW_LOOP_BODY(e8, OPERANDS, PARAMS, BODY); \
+    break; \
+  case e16: \
+    VI_SEW_LOOP_BODY(e16, OPERANDS, PARAMS, BODY); \
+    break; \
+  case e32: \
+    VI_SEW_LOOP_BODY(e32, OPERANDS, PARAMS, BODY); \
+    break; \
+  default: \
+    VI_SEW_LOOP_BODY(e64, OPERANDS, PARAMS, BODY); \
+    break; \
+  } \
+  P.VU.vstart->write(0);
+
 // genearl VXI signed/unsigned loop
 #define VI_VV_ULOOP(BODY) \
   VI_CHECK_SSS(true) \
-  VI_LOOP_BASE \
-  if (sew == e8) { \
-    VV_U_PARAMS(e8); \
-    BODY; \
-  } else if (sew == e16) { \
-    VV_U_PARAMS(e16); \
-    BODY; \
-  } else if (sew == e32) { \
-    VV_U_PARAMS(e32); \
-    BODY; \
-  } else if (sew == e64) { \
-    VV_U_PARAMS(e64); \
-    BODY; \
-  } \
-  VI_LOOP_END 
+  VI_SEW_LOOP(VV_U_OPERANDS, VV_U_GROUP_PARAMS, BODY)
 
 #define VI_VV_LOOP(BODY) \
   VI_CHECK_SSS(true) \
-  VI_LOOP_BASE \
-  if (sew == e8) { \
-    VV_PARAMS(e8); \
-    BODY; \
-  } else if (sew == e16) { \
-    VV_PARAMS(e16); \
-    BODY; \
-  } else if (sew == e32) { \
-    VV_PARAMS(e32); \
-    BODY; \
-  } else if (sew == e64) { \
-    VV_PARAMS(e64); \
-    BODY; \
-  } \
-  VI_LOOP_END 
+  VI_SEW_LOOP(VV_OPERANDS, VV_GROUP_PARAMS, BODY)
 
 #define VI_V_ULOOP(BODY) \
   VI_CHECK_SSS(false) \
-  VI_LOOP_BASE \
-  if (sew == e8) { \
-    V_U_PARAMS(e8); \
-    BODY; \
-  } else if (sew == e16) { \
-    V_U_PARAMS(e16); \
-    BODY; \
-  } else if (sew == e32) { \
-    V_U_PARAMS(e32); \
-    BODY; \
-  } else if (sew == e64) { \
-    V_U_PARAMS(e64); \
-    BODY; \
-  } \
-  VI_LOOP_END
+  VI_SEW_LOOP(V_U_OPERANDS, V_U_GROUP_PARAMS, BODY)
 
 #define VI_VX_ULOOP(BODY) \
   VI_CHECK_SSS(false) \
-  VI_LOOP_BASE \
-  if (sew == e8) { \
-    VX_U_PARAMS(e8); \
-    BODY; \
-  } else if (sew == e16) { \
-    VX_U_PARAMS(e16); \
-    BODY; \
-  } else if (sew == e32) { \
-    VX_U_PARAMS(e32); \
-    BODY; \
-  } else if (sew == e64) { \
-    VX_U_PARAMS(e64); \
-    BODY; \
-  } \
-  VI_LOOP_END 
+  VI_SEW_LOOP(VX_U_OPERANDS, VX_U_GROUP_PARAMS, BODY)
 
 #define VI_VX_LOOP(BODY) \
   VI_CHECK_SSS(false) \
-  VI_LOOP_BASE \
-  if (sew == e8) { \
-    VX_PARAMS(e8); \
-    BODY; \
-  } else if (sew == e16) { \
-    VX_PARAMS(e16); \
-    BODY; \
-  } else if (sew == e32) { \
-    VX_PARAMS(e32); \
-    BODY; \
-  } else if (sew == e64) { \
-    VX_PARAMS(e64); \
-    BODY; \
-  } \
-  VI_LOOP_END 
+  VI_SEW_LOOP(VX_OPERANDS, VX_GROUP_PARAMS, BODY)
 
 #define VI_VI_ULOOP(BODY) \
   VI_CHECK_SSS(false) \
-  VI_LOOP_BASE \
-  if (sew == e8) { \
-    VI_U_PARAMS(e8); \
-    BODY; \
-  } else if (sew == e16) { \
-    VI_U_PARAMS(e16); \
-    BODY; \
-  } else if (sew == e32) { \
-    VI_U_PARAMS(e32); \
-    BODY; \
-  } else if (sew == e64) { \
-    VI_U_PARAMS(e64); \
-    BODY; \
-  } \
-  VI_LOOP_END 
+  VI_SEW_LOOP(VI_U_OPERANDS, VI_U_GROUP_PARAMS, BODY)
 
 #define VI_VI_LOOP(BODY) \
   VI_CHECK_SSS(false) \
-  VI_LOOP_BASE \
-  if (sew == e8) { \
-    VI_PARAMS(e8); \
-    BODY; \
-  } else if (sew == e16) { \
-    VI_PARAMS(e16); \
-    BODY; \
-  } else if (sew == e32) { \
-    VI_PARAMS(e32); \
-    BODY; \
-  } else if (sew == e64) { \
-    VI_PARAMS(e64); \
-    BODY; \
-  } \
-  VI_LOOP_END 
+  VI_SEW_LOOP(VI_OPERANDS, VI_GROUP_PARAMS, BODY)
 
 // signed unsigned operation loop (e.g. mulhsu)
 #define VI_VV_SU_LOOP(BODY) \
   VI_CHECK_SSS(true) \
-  VI_LOOP_BASE \
-  if (sew == e8) { \
-    VV_SU_PARAMS(e8); \
-    BODY; \
-  } else if (sew == e16) { \
-    VV_SU_PARAMS(e16); \
-    BODY; \
-  } else if (sew == e32) { \
-    VV_SU_PARAMS(e32); \
-    BODY; \
-  } else if (sew == e64) { \
-    VV_SU_PARAMS(e64); \
-    BODY; \
-  } \
-  VI_LOOP_END 
+  VI_SEW_LOOP(VV_SU_OPERANDS, VV_SU_GROUP_PARAMS, BODY)
 
 #define VI_VX_SU_LOOP(BODY) \
   VI_CHECK_SSS(false) \
-  VI_LOOP_BASE \
-  if (sew == e8) { \
-    VX_SU_PARAMS(e8); \
-    BODY; \
-  } else if (sew == e16) { \
-    VX_SU_PARAMS(e16); \
-    BODY; \
-  } else if (sew == e32) { \
-    VX_SU_PARAMS(e32); \
-    BODY; \
-  } else if (sew == e64) { \
-    VX_SU_PARAMS(e64); \
-    BODY; \
-  } \
-  VI_LOOP_END 
+  VI_SEW_LOOP(VX_SU_OPERANDS, VX_SU_GROUP_PARAMS, BODY)
 
 // narrow operation loop
 #define VI_VV_LOOP_NARROW(BODY) \
@@ -1305,6 +1330,86 @@ reg_t index[P.VU.vlmax]; \
   } \
   P.VU.vstart->write(0);
 
+// Unit-stride accesses without segments copy each run of elements that
+// lies in one page directly between host memory and the register file,
+// when the page hits in the TLB.  Elements the TLB can't
+// serve go one at a time through the MMU, so that faults stay precise.
+#define VI_LDST_UNIT_RUN(elt_width, addr) \
+  (vreg_span_t<elt_width##_t>::contiguous ? \
+   std::min(vl - i, (PGSIZE - (addr) % PGSIZE) / sizeof(elt_width##_t)) : 0)
+
+#define VI_LDST_UNIT_ACTIVE(inx) \
+  (insn.v_vm() == 1 || ((P.VU.elt<uint64_t>(0, (inx) / 64) >> ((inx) % 64)) & 0x1))
+
+#define VI_LD_UNIT_RUN(elt_width, vd, host, run) \
+  auto reg = P.VU.elt_span<elt_width##_t>(vd, i, i + run, true); \
+  if (insn.v_vm() == 1) { \
+    memcpy(reg.data + i, host, run * sizeof(elt_width##_t)); \
+  } else { \
+    for (reg_t k = 0; k < run; ++k) \
+      if (VI_LDST_UNIT_ACTIVE(i + k)) \
+        memcpy(&reg[i + k], host + k * sizeof(elt_width##_t), sizeof(elt_width##_t)); \
+  }
+
+#define VI_LD_UNIT(elt_width, is_mask_ldst) \
+  if (insn.v_nf() != 0) { \
+    VI_LD(0, (i * nf + fn), elt_width, is_mask_ldst); \
+  } else { \
+    const reg_t nf = 1; \
+    const reg_t vl = is_mask_ldst ? ((P.VU.vl->read() + 7) / 8) : P.VU.vl->read(); \
+    const reg_t baseAddr = RS1; \
+    const reg_t vd = insn.rd(); \
+    VI_CHECK_LOAD(elt_width, is_mask_ldst); \
+    for (reg_t i = P.VU.vstart->read(); i < vl;) { \
+      const reg_t addr = baseAddr + i * sizeof(elt_width##_t); \
+      const reg_t run = VI_LDST_UNIT_RUN(elt_width, addr); \
+      const char *host = run ? MMU.load_host_ptr(addr, sizeof(elt_width##_t)) : NULL; \
+      P.VU.vstart->write(i); \
+      if (host) { \
+        VI_LD_UNIT_RUN(elt_width, vd, host, run); \
+        i += run; \
+      } else { \
+        if (VI_LDST_UNIT_ACTIVE(i)) \
+          P.VU.elt<elt_width##_t>(vd, i, true) = MMU.load<elt_width##_t>(addr); \
+        ++i; \
+      } \
+    } \
+    P.VU.vstart->write(0); \
+  }
+
+#define VI_ST_UNIT(elt_width, is_mask_ldst) \
+  if (insn.v_nf() != 0) { \
+    VI_ST(0, (i * nf + fn), elt_width, is_mask_ldst); \
+  } else { \
+    const reg_t nf = 1; \
+    const reg_t vl = is_mask_ldst ? ((P.VU.vl->read() + 7) / 8) : P.VU.vl->read(); \
+    const reg_t baseAddr = RS1; \
+    const reg_t vs3 = insn.rd(); \
+    VI_CHECK_STORE(elt_width, is_mask_ldst); \
+    for (reg_t i = P.VU.vstart->read(); i < vl;) { \
+      const reg_t addr = baseAddr + i * sizeof(elt_width##_t); \
+      const reg_t run = VI_LDST_UNIT_RUN(elt_width, addr); \
+      char *host = run ? MMU.store_host_ptr(addr, sizeof(elt_width##_t)) : NULL; \
+      P.VU.vstart->write(i); \
+      if (host) { \
+        auto reg = P.VU.elt_span<elt_width##_t>(vs3, i, i + run); \
+        if (insn.v_vm() == 1) { \
+          memcpy(host, reg.data + i, run * sizeof(elt_width##_t)); \
+        } else { \
+          for (reg_t k = 0; k < run; ++k) \
+            if (VI_LDST_UNIT_ACTIVE(i + k)) \
+              memcpy(host + k * sizeof(elt_width##_t), &reg[i + k], sizeof(elt_width##_t)); \
+        } \
+        i += run; \
+      } else { \
+        if (VI_LDST_UNIT_ACTIVE(i)) \
+          MMU.store<elt_width##_t>(addr, P.VU.elt<elt_width##_t>(vs3, i)); \
+        ++i; \
+      } \
+    } \
+    P.VU.vstart->write(0); \
+  }
+
 #define VI_LDST_FF(elt_width) \
   const reg_t nf = insn.v_nf() + 1; \
   const reg_t vl = p->VU.vl->read(); \
@@ -1313,6 +1418,16 @@ reg_t index[P.VU.vlmax]; \
   VI_CHECK_LOAD(elt_width, false); \
   bool early_stop = false; \
   for (reg_t i = p->VU.vstart->read(); i < vl; ++i) { \
+    if (nf == 1) { \
+      const reg_t addr = baseAddr + i * sizeof(elt_width##_t); \
+      const reg_t run = VI_LDST_UNIT_RUN(elt_width, addr); \
+      const char *host = run ? MMU.load_host_ptr(addr, sizeof(elt_width##_t)) : NULL; \
+      if (host) { \
+        VI_LD_UNIT_RUN(elt_width, rd_num, host, run); \
+        i += run - 1; \
+        continue; \
+      } \
+    } \
     VI_STRIP(i); \
     VI_ELEMENT_SKIP; \
     \
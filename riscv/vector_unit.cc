@@ -86,6 +86,27 @@ template<class T> T& vectorUnit_t::elt(reg_t vReg, reg_t n, bool UNUSED is_write
   return regStart[n];
 }
 
+template<class T> vreg_span_t<T>
+vectorUnit_t::elt_span(reg_t vReg, reg_t start, reg_t end, bool UNUSED is_write) {
+  assert(vsew != 0);
+  assert((VLEN >> 3)/sizeof(T) > 0);
+  reg_t elts_per_reg = (VLEN >> 3) / (sizeof(T));
+  for (reg_t n = start; n < end; n += elts_per_reg - n % elts_per_reg) {
+    reg_t reg = vReg + n / elts_per_reg;
+    reg_referenced[reg] = 1;
+
+    if (unlikely(p->get_log_commits_enabled() && is_write))
+      p->get_state()->log_reg_write[(reg << 4) | 2] = {0, 0};
+  }
+
+  vreg_span_t<T> span;
+  span.data = (T*)((char*)reg_file + vReg * (VLEN >> 3));
+#ifdef WORDS_BIGENDIAN
+  span.elts_per_reg = elts_per_reg;
+#endif
+  return span;
+}
+
 // The logic differences between 'elt()' and 'elt_group()' come from
 // the fact that, while 'elt()' requires that the element is fully
 // contained in a single vector register, the element group may span
@@ -149,6 +170,15 @@ template float16_t& vectorUnit_t::elt<float16_t>(reg_t, reg_t, bool);
 template float32_t& vectorUnit_t::elt<float32_t>(reg_t, reg_t, bool);
 template float64_t& vectorUnit_t::elt<float64_t>(reg_t, reg_t, bool);
 
+template vreg_span_t<int8_t> vectorUnit_t::elt_span<int8_t>(reg_t, reg_t, reg_t, bool);
+template vreg_span_t<int16_t> vectorUnit_t::elt_span<int16_t>(reg_t, reg_t, reg_t, bool);
+template vreg_span_t<int32_t> vectorUnit_t::elt_span<int32_t>(reg_t, reg_t, reg_t, bool);
+template vreg_span_t<int64_t> vectorUnit_t::elt_span<int64_t>(reg_t, reg_t, reg_t, bool);
+template vreg_span_t<uint8_t> vectorUnit_t::elt_span<uint8_t>(reg_t, reg_t, reg_t, bool);
+template vreg_span_t<uint16_t> vectorUnit_t::elt_span<uint16_t>(reg_t, reg_t, reg_t, bool);
+template vreg_span_t<uint32_t> vectorUnit_t::elt_span<uint32_t>(reg_t, reg_t, reg_t, bool);
+template vreg_span_t<uint64_t> vectorUnit_t::elt_span<uint64_t>(reg_t, reg_t, reg_t, bool);
+
 template EGU32x4_t& vectorUnit_t::elt_group<EGU32x4_t>(reg_t, reg_t, bool);
 template EGU32x8_t& vectorUnit_t::elt_group<EGU32x8_t>(reg_t, reg_t, bool);
 template EGU64x4_t& vectorUnit_t::elt_group<EGU64x4_t>(reg_t, reg_t, bool);
@@ -5,6 +5,7 @@
 #include <array>
 #include <cstdint>
 
+#include "config.h"
 #include "decode.h"
 #include "csrs.h"
 
@@ -84,6 +85,25 @@ using EGU64x4_t = std::array<uint64_t, 4>;
 // Element Group of 16 8 bits elements (128b total).
 using EGU8x16_t = std::array<uint8_t, 16>;
 
+// Elements of a register group, indexed by element number as in
+// vectorUnit_t::elt().  On big-endian hosts, each register holds its
+// elements from the end, so they aren't contiguous in memory.
+template<class T>
+struct vreg_span_t
+{
+  T* data;  // the first register of the group
+#ifdef WORDS_BIGENDIAN
+  static const bool contiguous = false;
+  reg_t elts_per_reg;
+
+  T& operator[](reg_t n) const { return data[n ^ (elts_per_reg - 1)]; }
+#else
+  static const bool contiguous = true;
+
+  T& operator[](reg_t n) const { return data[n]; }
+#endif
+};
+
 class vectorUnit_t
 {
 public:
@@ -104,6 +124,11 @@ public:
 
   // vector element for various SEW
   template<class T> T& elt(reg_t vReg, reg_t n, bool is_write = false);
+  // elements [start, end) of the register group at vReg, for loops over
+  // many elements: marks the registers they lie in once, rather than for
+  // each element as elt() does
+  template<class T> vreg_span_t<T>
+  elt_span(reg_t vReg, reg_t start, reg_t end, bool is_write = false);
   // vector element group access, where EG is a std::array<T, N>.
   template<typename EG> EG&
   elt_group(reg_t vReg, reg_t n, bool is_write = false);
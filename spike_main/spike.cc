@@ -48,6 +48,13 @@ static void help(int exit_code = 1)
   fprintf(stderr, "  --ic=<S>:<W>:<B>      Instantiate a cache model with S sets,\n");
   fprintf(stderr, "  --dc=<S>:<W>:<B>        W ways, and B-byte blocks (with S and\n");
   fprintf(stderr, "  --l2=<S>:<W>:<B>        B both powers of 2).\n");
+  fprintf(stderr, "  --tlb=<S>:<W>         Keep translations across address space switches\n");
+  fprintf(stderr, "                          in a TLB with S sets (a power of 2) and W ways\n");
+  fprintf(stderr, "                          [default 256:4]\n");
+  fprintf(stderr, "  --tlb-stats           Print TLB and page-walk cache hit rates on exit\n");
+  fprintf(stderr, "  --huge-pages          Back target memory with transparent huge pages\n");
+  fprintf(stderr, "  --mem-image=<a>:<f>   Start the memory region at base address a with the\n");
+  fprintf(stderr, "                          contents of file f, mapped copy-on-write\n");
   fprintf(stderr, "  --big-endian          Use a big-endian memory system.\n");
   fprintf(stderr, "  --misaligned          Support misaligned memory accesses\n");
   fprintf(stderr, "  --device=<name>       Attach MMIO plugin device from an --extlib library\n");
@@ -67,6 +74,15 @@ static void help(int exit_code = 1)
           DEFAULT_KERNEL_BOOTARGS);
   fprintf(stderr, "  --real-time-clint     Increment clint time at real-time rate\n");
   fprintf(stderr, "  --triggers=<n>        Number of supported triggers [default 4]\n");
+  fprintf(stderr, "  --jit                 Translate hot RV64 integer code to host code\n");
+  fprintf(stderr, "  --fuse                Execute common pairs of instructions as one\n");
+  fprintf(stderr, "  --skip-idle           Advance time straight to the next timer interrupt\n");
+  fprintf(stderr, "                          when all harts are waiting for interrupts\n");
+  fprintf(stderr, "  --threads=<n>         Run harts concurrently on <n> host threads [default 1]\n");
+  fprintf(stderr, "  --quantum=<n>         Instructions each hart runs between synchronizations\n");
+  fprintf(stderr, "                          of concurrent harts [default 5000]\n");
+  fprintf(stderr, "  --deterministic       Make multi-hart runs independent of --threads\n");
+  fprintf(stderr, "                          and of host timing\n");
   fprintf(stderr, "  --dm-progsize=<words> Progsize for the debug module [default 2]\n");
   fprintf(stderr, "  --dm-sba=<bits>       Debug system bus access supports up to "
       "<bits> wide accesses [default 0]\n");
@@ -260,12 +276,32 @@ static std::vector<mem_cfg_t> parse_mem_layout(const char* arg)
   return merged_mem;
 }
 
-static std::vector<std::pair<reg_t, abstract_mem_t*>> make_mems(const std::vector<mem_cfg_t> &layout)
+static std::vector<std::pair<reg_t, abstract_mem_t*>> make_mems(const std::vector<mem_cfg_t> &layout,
+                                                                 bool huge_pages,
+                                                                 std::map<reg_t, const char*> images)
 {
   std::vector<std::pair<reg_t, abstract_mem_t*>> mems;
   mems.reserve(layout.size());
   for (const auto &cfg : layout) {
-    mems.push_back(std::make_pair(cfg.get_base(), new mem_t(cfg.get_size())));
+    auto image = images.find(cfg.get_base());
+    if (image == images.end()) {
+      mems.push_back(std::make_pair(cfg.get_base(), new mem_t(cfg.get_size(), huge_pages)));
+      continue;
+    }
+
+    try {
+      mems.push_back(std::make_pair(cfg.get_base(), new image_mem_t(cfg.get_size(), image->second)));
+    } catch (const std::runtime_error& e) {
+      fprintf(stderr, "%s\n", e.what());
+      exit(-1);
+    }
+    images.erase(image);
+  }
+
+  if (!images.empty()) {
+    fprintf(stderr, "--mem-image base 0x%" PRIx64 " isn't the base of a memory region\n",
+            images.begin()->first);
+    exit(-1);
   }
   return mems;
 }
@@ -325,6 +361,8 @@ int main(int argc, char** argv)
   bool debug = false;
   bool halted = false;
   bool histogram = false;
+  bool huge_pages = false;
+  std::map<reg_t, const char*> mem_images;
   bool log = false;
   bool UNUSED socket = false;  // command line option -s
   bool dump_dts = false;
@@ -401,6 +439,26 @@ int main(int argc, char** argv)
   parser.option(0, "ic", 1, [&](const char* s){ic.reset(new icache_sim_t(s));});
   parser.option(0, "dc", 1, [&](const char* s){dc.reset(new dcache_sim_t(s));});
   parser.option(0, "l2", 1, [&](const char* s){l2.reset(cache_sim_t::construct(s, "L2$"));});
+  parser.option(0, "tlb", 1, [&](const char* s){
+    char* ways;
+    cfg.tlb_sets = strtoul(s, &ways, 0);
+    cfg.tlb_ways = *ways == ':' ? strtoul(ways + 1, &ways, 0) : 0;
+    if (*ways || cfg.tlb_sets == 0 || (cfg.tlb_sets & (cfg.tlb_sets - 1)) != 0 || cfg.tlb_ways == 0) {
+      fprintf(stderr, "--tlb must be <sets>:<ways>, with sets a power of 2 and ways nonzero\n");
+      exit(-1);
+    }
+  });
+  parser.option(0, "huge-pages", 0, [&](const char UNUSED *s){huge_pages = true;});
+  parser.option(0, "mem-image", 1, [&](const char* s){
+    char* file;
+    reg_t base = strtoull(s, &file, 0);
+    if (*file != ':' || !file[1]) {
+      fprintf(stderr, "--mem-image must be <base>:<file>\n");
+      exit(-1);
+    }
+    mem_images[base] = file + 1;
+  });
+  parser.option(0, "tlb-stats", 0, [&](const char UNUSED *s){cfg.tlb_stats = true;});
   parser.option(0, "big-endian", 0, [&](const char UNUSED *s){cfg.endianness = endianness_big;});
   parser.option(0, "misaligned", 0, [&](const char UNUSED *s){cfg.misaligned = true;});
   parser.option(0, "log-cache-miss", 0, [&](const char UNUSED *s){log_cache = true;});
@@ -418,6 +476,12 @@ int main(int argc, char** argv)
   parser.option(0, "bootargs", 1, [&](const char* s){cfg.bootargs = s;});
   parser.option(0, "real-time-clint", 0, [&](const char UNUSED *s){cfg.real_time_clint = true;});
   parser.option(0, "triggers", 1, [&](const char *s){cfg.trigger_count = atoul_safe(s);});
+  parser.option(0, "jit", 0, [&](const char UNUSED *s){cfg.jit = true;});
+  parser.option(0, "fuse", 0, [&](const char UNUSED *s){cfg.fuse = true;});
+  parser.option(0, "skip-idle", 0, [&](const char UNUSED *s){cfg.skip_idle = true;});
+  parser.option(0, "threads", 1, [&](const char *s){cfg.threads = atoul_nonzero_safe(s);});
+  parser.option(0, "quantum", 1, [&](const char *s){cfg.quantum = atoul_nonzero_safe(s);});
+  parser.option(0, "deterministic", 0, [&](const char UNUSED *s){cfg.deterministic = true;});
   parser.option(0, "extlib", 1, [&](const char *s){
     void *lib = dlopen(s, RTLD_NOW | RTLD_GLOBAL);
     if (lib == NULL) {
@@ -474,7 +538,7 @@ int main(int argc, char** argv)
     help();
 
   std::vector<std::pair<reg_t, abstract_mem_t*>> mems =
-      make_mems(cfg.mem_layout());
+      make_mems(cfg.mem_layout(), huge_pages, mem_images);
 
   if (kernel && check_file_exists(kernel)) {
     const char *isa = cfg.isa();